@@ -28,6 +28,39 @@ void printSummary(const csim_stats_t *stats) {
            stats->hits, stats->misses, stats->evictions, stats->dirty_bytes,
            stats->dirty_evictions);
 
+    /* opt-in miss-classification breakdown (csim --classify) */
+    if (stats->miss_breakdown) {
+        printf("compulsory_misses:%ld capacity_misses:%ld "
+               "conflict_misses:%ld\n",
+               stats->compulsory_misses, stats->capacity_misses,
+               stats->conflict_misses);
+    }
+
+    /* opt-in prefetch engine counters (csim --prefetch) */
+    if (stats->prefetch_stats) {
+        printf("prefetches:%ld prefetch_useful:%ld prefetch_useless:%ld "
+               "prefetch_late:%ld\n",
+               stats->prefetches, stats->prefetch_useful,
+               stats->prefetch_useless, stats->prefetch_late);
+    }
+
+    /* memory write traffic of the write-through modes (csim -w) */
+    if (stats->write_stats) {
+        printf("memory_write_traffic:%ld\n", stats->write_traffic);
+    }
+
+    /* TLB counters of the translation stage (csim --tlb) */
+    if (stats->tlb_stats) {
+        printf("tlb_hits:%ld tlb_misses:%ld\n", stats->tlb_hits,
+               stats->tlb_misses);
+    }
+
+    /* cycle-cost model of the run (csim --cost) */
+    if (stats->cost_stats) {
+        printf("total_cycles:%ld amat:%.3f\n", stats->total_cycles,
+               stats->amat);
+    }
+
     FILE *output_fp = fopen(".csim_results", "w");
     if (output_fp == NULL) {
         fprintf(stderr, "Error: failed to open results file: %s\n",
@@ -63,6 +96,25 @@ bool loadSummary(csim_stats_t *stats) {
         return false;
     }
 
+    /* the results file carries no classification breakdown */
+    stats->compulsory_misses = 0;
+    stats->capacity_misses = 0;
+    stats->conflict_misses = 0;
+    stats->miss_breakdown = false;
+    stats->prefetches = 0;
+    stats->prefetch_useful = 0;
+    stats->prefetch_useless = 0;
+    stats->prefetch_late = 0;
+    stats->prefetch_stats = false;
+    stats->write_traffic = 0;
+    stats->write_stats = false;
+    stats->tlb_hits = 0;
+    stats->tlb_misses = 0;
+    stats->tlb_stats = false;
+    stats->total_cycles = 0;
+    stats->amat = 0;
+    stats->cost_stats = false;
+
     fclose(fp);
     return true;
 }
@@ -20,6 +20,24 @@ typedef struct {
                                       at end of simulation */
     unsigned long dirty_evictions; /* number of bytes evicted
                                       from dirty lines */
+    unsigned long compulsory_misses; /* misses to never-referenced blocks */
+    unsigned long capacity_misses;   /* misses a fully-associative cache
+                                        of equal capacity also takes */
+    unsigned long conflict_misses;   /* misses caused by the set mapping */
+    bool miss_breakdown;             /* the three fields above are valid */
+    unsigned long prefetches;        /* prefetches issued */
+    unsigned long prefetch_useful;   /* prefetched lines used on a hit */
+    unsigned long prefetch_useless;  /* prefetched lines evicted unused */
+    unsigned long prefetch_late;     /* demand misses on pending blocks */
+    bool prefetch_stats;             /* the four fields above are valid */
+    unsigned long write_traffic;     /* bytes written through to memory */
+    bool write_stats;                /* write_traffic is valid */
+    unsigned long tlb_hits;          /* TLB hits of the translation stage */
+    unsigned long tlb_misses;        /* TLB misses (page walks) */
+    bool tlb_stats;                  /* the two fields above are valid */
+    unsigned long total_cycles;      /* cycles under the cost model */
+    double amat;                     /* average memory access time */
+    bool cost_stats;                 /* the two fields above are valid */
 } csim_stats_t;
 
 /** @brief Store a summary of the cache simulation statistics. */
@@ -0,0 +1,110 @@
+/*
+ * @file csim-bench.c
+ * @brief Benchmarks the cache simulator over a trace/config matrix
+ *
+ * Runs csim with -B on every combination of the given trace files and a
+ * fixed set of cache configurations, collecting the per-phase timing line
+ * csim prints (parse, simulate, report) and the accesses/second
+ * throughput. Results are shown as a table plus one machine-readable
+ * BENCH_RESULT line per run for scripts to consume.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_STR 1024 /* Max string size */
+
+typedef struct {
+    int s;
+    int E;
+    int b;
+} bench_config_t;
+
+/** @brief Cache configurations every trace is benchmarked against */
+static const bench_config_t BENCH_CONFIGS[] = {
+    {.s = 5, .E = 1, .b = 5},     // small direct-mapped
+    {.s = 6, .E = 8, .b = 6},     // Haswell-like L1
+    {.s = 8, .E = 16, .b = 4},    // mid-size, SIMD match path
+    {.s = 14, .E = 1024, .b = 3}, // high associativity, recency lists
+};
+
+#define N_CONFIGS (sizeof(BENCH_CONFIGS) / sizeof(BENCH_CONFIGS[0]))
+
+/*
+ * usage - Prints usage info
+ */
+static void usage(char *argv[]) {
+    printf("Usage: %s <trace> [<trace> ...]\n", argv[0]);
+    printf("Benchmarks ./csim against each trace and configuration.\n");
+}
+
+/**
+ * @brief Runs one csim benchmark and parses its timing line.
+ *
+ * @param[in]  trace  The trace file to replay
+ * @param[in]  cfg    The cache configuration to simulate
+ *
+ * @return false if any problems, true if OK.
+ */
+static bool run_bench(const char *trace, const bench_config_t *cfg) {
+    char cmd[MAX_STR];
+    sprintf(cmd, "./csim -B -s %d -E %d -b %d -t %s", cfg->s, cfg->E, cfg->b,
+            trace);
+
+    FILE *fp = popen(cmd, "r");
+    if (!fp) {
+        fprintf(stderr, "Error invoking csim: '%s'\n", cmd);
+        return false;
+    }
+
+    double parseSec = -1, simSec = -1, reportSec = -1, accPerSec = -1;
+    long accesses = -1;
+    char linebuf[MAX_STR];
+    while (fgets(linebuf, sizeof(linebuf), fp)) {
+        if (sscanf(linebuf,
+                   "bench: parse_s=%lf simulate_s=%lf report_s=%lf "
+                   "accesses=%ld accesses_per_s=%lf",
+                   &parseSec, &simSec, &reportSec, &accesses,
+                   &accPerSec) == 5) {
+            break;
+        }
+    }
+    if (pclose(fp) != 0 || accesses < 0) {
+        fprintf(stderr, "Benchmark run failed: '%s'\n", cmd);
+        return false;
+    }
+
+    printf("%6d %6d %6d %10.4f %10.4f %10.4f %10ld %12.0f  %s\n", cfg->s,
+           cfg->E, cfg->b, parseSec, simSec, reportSec, accesses, accPerSec,
+           trace);
+    printf("BENCH_RESULT trace=%s s=%d E=%d b=%d parse_s=%f simulate_s=%f "
+           "report_s=%f accesses=%ld accesses_per_s=%f\n",
+           trace, cfg->s, cfg->E, cfg->b, parseSec, simSec, reportSec,
+           accesses, accPerSec);
+    return true;
+}
+
+/**
+ * @brief Main routine
+ */
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        usage(argv);
+        return 1;
+    }
+
+    printf("%6s %6s %6s %10s %10s %10s %10s %12s\n", "s", "E", "b", "parse_s",
+           "sim_s", "report_s", "accesses", "acc/s");
+
+    int failures = 0;
+    for (int i = 1; i < argc; i++) {
+        for (size_t j = 0; j < N_CONFIGS; j++) {
+            if (!run_bench(argv[i], &BENCH_CONFIGS[j])) {
+                failures++;
+            }
+        }
+    }
+    return failures > 0;
+}
@@ -0,0 +1,340 @@
+/*
+ * @file csim-fuzz.c
+ * @brief Differential fuzzer for the optimized simulation engines
+ *
+ * test-csim.c checks csim against csim-ref over 11 fixed configurations,
+ * which is not enough coverage for the optimized engines (SIMD tag
+ * match, recency-list LRU, specialized batch kernels, run-length
+ * collapsing). This harness generates random cache configurations and
+ * synthetic traces with tunable locality, runs ./csim in its default
+ * optimized form against ./csim --scalar (the naive reference paths),
+ * and diffs the resulting statistics plus the final cache state saved
+ * with -C. Both runs use -B, so every iteration also reports the
+ * throughput of the two engines side by side.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cachelab.h"
+
+#define MAX_STR 1024 /* Max string size */
+
+/** @brief Trace and state files every iteration overwrites */
+#define FUZZ_TRACE "fuzz.trace"
+#define FUZZ_STATE_OPT "fuzz-opt.state"
+#define FUZZ_STATE_REF "fuzz-ref.state"
+
+/** @brief Associativities drawn by the generator */
+static const int FUZZ_ASSOC[] = {1, 2, 3, 4, 8, 13, 16, 64, 256};
+
+/** @brief Replacement policies drawn by the generator */
+static const char *FUZZ_POLICY[] = {"lru", "lru", "lru", "lru",
+                                    "plru", "srrip", "rand"};
+
+#define N_ASSOC (sizeof(FUZZ_ASSOC) / sizeof(FUZZ_ASSOC[0]))
+#define N_POLICY (sizeof(FUZZ_POLICY) / sizeof(FUZZ_POLICY[0]))
+
+/** @brief One generated configuration plus trace-shape knobs */
+typedef struct {
+    int s, E, b;
+    const char *policy;
+    int collapse;       // run the optimized engine with --collapse
+    long accesses;      // trace length
+    long workingBlocks; // distinct blocks the trace cycles through
+    int maxRun;         // longest run of one repeated access
+} fuzz_config_t;
+
+static unsigned long rngState;
+
+/** @brief xorshift64 step, the same generator csim uses internally */
+static unsigned long fuzz_rand(void) {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return rngState;
+}
+
+/*
+ * usage - Prints usage info
+ */
+static void usage(char *argv[]) {
+    printf("Usage: %s [iterations] [seed]\n", argv[0]);
+    printf("Fuzzes ./csim against its --scalar reference paths.\n");
+}
+
+/**
+ * @brief Draws one random configuration and trace shape.
+ */
+static void gen_config(fuzz_config_t *cfg) {
+    cfg->s = (int)(fuzz_rand() % 9);
+    cfg->E = FUZZ_ASSOC[fuzz_rand() % N_ASSOC];
+    cfg->b = 3 + (int)(fuzz_rand() % 4);
+    cfg->policy = FUZZ_POLICY[fuzz_rand() % N_POLICY];
+    // the PLRU tree needs a power-of-two associativity
+    if (strcmp(cfg->policy, "plru") == 0 && (cfg->E & (cfg->E - 1)) != 0) {
+        cfg->policy = "lru";
+    }
+    cfg->collapse = fuzz_rand() % 2 == 0;
+    cfg->accesses = 10000 + (long)(fuzz_rand() % 90000);
+    // working set from cache-resident to heavily thrashing
+    cfg->workingBlocks = 8 + (long)(fuzz_rand() % (1UL << 14));
+    cfg->maxRun = 1 + (int)(fuzz_rand() % 64);
+}
+
+/**
+ * @brief Writes a synthetic trace matching the configured shape.
+ *
+ * Addresses cycle through a bounded working set with occasional strided
+ * walks, and each chosen access repeats up to maxRun times so the
+ * run-length collapse path sees real runs.
+ *
+ * @return false if any problems, true if OK.
+ */
+static bool gen_trace(const fuzz_config_t *cfg) {
+    FILE *fp = fopen(FUZZ_TRACE, "w");
+    if (!fp) {
+        fprintf(stderr, "Error opening'%s'\n", FUZZ_TRACE);
+        return false;
+    }
+
+    long emitted = 0;
+    while (emitted < cfg->accesses) {
+        unsigned long block = fuzz_rand() % (unsigned long)cfg->workingBlocks;
+        unsigned long addr = (block << cfg->b) | (fuzz_rand() & 7);
+        char op = fuzz_rand() % 4 == 0 ? 'S' : 'L';
+        long run = 1 + (long)(fuzz_rand() % (unsigned long)cfg->maxRun);
+
+        if (fuzz_rand() % 8 == 0) {
+            // strided walk instead of a repeat run
+            for (long i = 0; i < run && emitted < cfg->accesses; i++) {
+                fprintf(fp, "%c %lx,4\n", op, addr + (unsigned long)i * 64);
+                emitted++;
+            }
+        } else {
+            for (long i = 0; i < run && emitted < cfg->accesses; i++) {
+                fprintf(fp, "%c %lx,4\n", op, addr);
+                emitted++;
+            }
+        }
+    }
+    fclose(fp);
+    return true;
+}
+
+/**
+ * @brief Runs one csim invocation, collecting stats and throughput.
+ *
+ * @param[in]  cmd     The command used to invoke csim
+ * @param[out] stats   The statistics collected from this run
+ * @param[out] accPerS The accesses/second of the simulate phase
+ *
+ * @return false if any problems, true if OK.
+ */
+static bool run_csim(const char *cmd, csim_stats_t *stats, double *accPerS) {
+    int status = unlink(".csim_results");
+    if (status < 0 && errno != ENOENT) {
+        fprintf(stderr, "Error removing old simulation results: %s\n",
+                strerror(errno));
+        return false;
+    }
+
+    FILE *fp = popen(cmd, "r");
+    if (!fp) {
+        fprintf(stderr, "Error invoking csim: '%s'\n", cmd);
+        return false;
+    }
+
+    *accPerS = 0;
+    double parseSec, simSec, reportSec;
+    long accesses;
+    char linebuf[MAX_STR];
+    while (fgets(linebuf, sizeof(linebuf), fp)) {
+        sscanf(linebuf,
+               "bench: parse_s=%lf simulate_s=%lf report_s=%lf "
+               "accesses=%ld accesses_per_s=%lf",
+               &parseSec, &simSec, &reportSec, &accesses, accPerS);
+    }
+    if (pclose(fp) != 0) {
+        fprintf(stderr, "Error running csim: '%s'\n", cmd);
+        return false;
+    }
+
+    if (!loadSummary(stats)) {
+        return false;
+    }
+    status = unlink(".csim_results");
+    (void)status;
+    return true;
+}
+
+/** @brief Header leading a state file; mirrors save_state() in csim.c */
+typedef struct {
+    unsigned long magic;
+    int version;
+    int s, b, E;
+    int policy;
+} fuzz_state_header_t;
+
+/**
+ * @brief Compares the two saved cache states, field for field.
+ *
+ * The scalar reference keeps LRU order in the timestamps only, so the
+ * recency-list link arrays legitimately differ between the two files;
+ * everything else (header, counters, tags, timestamps, valid/dirty/
+ * prefetch bitmasks and the random state) must match byte for byte.
+ * Only called for LRU runs, which carry no policy state after the
+ * bitmasks.
+ *
+ * @return false if the states differ, true if they match.
+ */
+static bool compare_states(const fuzz_config_t *cfg) {
+    FILE *fa = fopen(FUZZ_STATE_OPT, "rb");
+    FILE *fb = fopen(FUZZ_STATE_REF, "rb");
+    if (!fa || !fb) {
+        fprintf(stderr, "Error opening the saved states\n");
+        return false;
+    }
+
+    long S = 1L << cfg->s;
+    long nLines = S * cfg->E;
+    long maskWords = S * ((cfg->E + 63) / 64);
+
+    // byte spans of the two files, in save_state() write order
+    struct {
+        long bytes;
+        bool skip;
+    } spans[] = {
+        {(long)sizeof(fuzz_state_header_t), false}, // header
+        {7 * 8, false},                             // SimStats counters
+        {2 * S * 4, true},                          // lruHead, lruTail
+        {nLines * 8, false},                        // tags
+        {nLines * 4, false},                        // timestamps
+        {2 * nLines * 4, true},                     // lruPrev, lruNext
+        {3 * maskWords * 8, false},                 // valid, dirty, pf
+        {8, false},                                 // random state
+    };
+
+    bool same = true;
+    for (size_t i = 0; same && i < sizeof(spans) / sizeof(spans[0]); i++) {
+        static char bufa[MAX_STR], bufb[MAX_STR];
+        long left = spans[i].bytes;
+        while (left > 0) {
+            long chunk = left < MAX_STR ? left : MAX_STR;
+            if (fread(bufa, 1, (size_t)chunk, fa) != (size_t)chunk ||
+                fread(bufb, 1, (size_t)chunk, fb) != (size_t)chunk) {
+                same = false;
+                break;
+            }
+            if (!spans[i].skip && memcmp(bufa, bufb, (size_t)chunk) != 0) {
+                same = false;
+                break;
+            }
+            left -= chunk;
+        }
+    }
+    fclose(fa);
+    fclose(fb);
+    return same;
+}
+
+/**
+ * @brief Runs one fuzz iteration: generate, simulate twice, diff.
+ *
+ * @return false on a mismatch or run failure, true if identical.
+ */
+static bool fuzz_one(int iter, const fuzz_config_t *cfg) {
+    if (!gen_trace(cfg)) {
+        return false;
+    }
+
+    bool isLru = strcmp(cfg->policy, "lru") == 0;
+    char cmd[MAX_STR];
+    csim_stats_t opt, ref;
+    double optAccS, refAccS;
+
+    sprintf(cmd, "./csim -B -s %d -E %d -b %d -p %s%s -t %s -C %s",
+            cfg->s, cfg->E, cfg->b, cfg->policy,
+            cfg->collapse ? " --collapse" : "", FUZZ_TRACE, FUZZ_STATE_OPT);
+    if (!run_csim(cmd, &opt, &optAccS)) {
+        return false;
+    }
+
+    sprintf(cmd, "./csim -B --scalar -s %d -E %d -b %d -p %s -t %s -C %s",
+            cfg->s, cfg->E, cfg->b, cfg->policy, FUZZ_TRACE, FUZZ_STATE_REF);
+    if (!run_csim(cmd, &ref, &refAccS)) {
+        return false;
+    }
+
+    bool statsSame =
+        opt.hits == ref.hits && opt.misses == ref.misses &&
+        opt.evictions == ref.evictions && opt.dirty_bytes == ref.dirty_bytes &&
+        opt.dirty_evictions == ref.dirty_evictions;
+    bool stateSame = !isLru || compare_states(cfg);
+
+    printf("%4d  s=%d E=%-4d b=%d %-6s%s  accesses=%-6ld  "
+           "opt=%.0f/s ref=%.0f/s (%.2fx)  %s\n",
+           iter, cfg->s, cfg->E, cfg->b, cfg->policy,
+           cfg->collapse ? " +collapse" : "          ", cfg->accesses,
+           optAccS, refAccS, refAccS > 0 ? optAccS / refAccS : 0,
+           statsSame && stateSame ? "identical" : "MISMATCH");
+
+    if (!statsSame) {
+        printf("      opt: hits:%ld misses:%ld evictions:%ld "
+               "dirty_bytes:%ld dirty_evictions:%ld\n",
+               opt.hits, opt.misses, opt.evictions, opt.dirty_bytes,
+               opt.dirty_evictions);
+        printf("      ref: hits:%ld misses:%ld evictions:%ld "
+               "dirty_bytes:%ld dirty_evictions:%ld\n",
+               ref.hits, ref.misses, ref.evictions, ref.dirty_bytes,
+               ref.dirty_evictions);
+    } else if (!stateSame) {
+        printf("      final cache states differ\n");
+    }
+    return statsSame && stateSame;
+}
+
+/**
+ * @brief Main routine
+ */
+int main(int argc, char *argv[]) {
+    if (argc > 3) {
+        usage(argv);
+        return 1;
+    }
+    int iterations = argc > 1 ? atoi(argv[1]) : 25;
+    rngState = argc > 2 ? strtoul(argv[2], NULL, 0) : 88172645463325252UL;
+    if (iterations <= 0 || rngState == 0) {
+        usage(argv);
+        return 1;
+    }
+    printf("fuzzing %d configurations, seed %lu\n", iterations, rngState);
+
+    int passed = 0;
+    for (int i = 0; i < iterations; i++) {
+        fuzz_config_t cfg;
+        gen_config(&cfg);
+        if (i == 0) {
+            // one long-trace iteration: a small set kept full and
+            // thrashing for >10M accesses exercises the victim scans
+            // and recency clocks far past where short bursts ever get
+            static const int longAssoc[] = {2, 4, 8};
+            cfg.s = (int)(fuzz_rand() % 3);
+            cfg.E = longAssoc[fuzz_rand() % 3];
+            cfg.policy = "lru";
+            cfg.accesses = 10500000;
+            cfg.workingBlocks = (1L << cfg.s) * cfg.E + 1;
+            cfg.maxRun = 8;
+        }
+        if (fuzz_one(i, &cfg)) {
+            passed++;
+        }
+    }
+
+    printf("fuzz: %d/%d configurations identical\n", passed, iterations);
+    return passed != iterations;
+}
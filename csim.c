@@ -1,26 +1,141 @@
 #include "cachelab.h"
+#include "tracepack.h"
 #include <assert.h>
+#include <fcntl.h>
 #include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 const int LINELEN = 21;
 const long MAX_SIZE = 16;
 
-typedef struct line {
-    int valid;
-    long tag;
-    int dirty;
-    int timeStamp;
-} Line;
+/*
+ * Line metadata is kept as parallel arrays rather than an array of
+ * structs: the packed tags and the per-set valid bitmask feed the match
+ * kernels, dirty and prefetch state are one bit per line in bitmasks of
+ * the same shape, and the recency data (timestamps, list links) lives
+ * in arrays only the eviction path reads. The match loop therefore
+ * drags no replacement or dirty state through the host cache, and a
+ * line costs tag + timestamp + links + 3 bits instead of a 40-byte
+ * struct.
+ */
+
+/** @brief Counter block for one simulation stream.
+ *
+ * A single-config run uses the block embedded in its Cache; each worker
+ * thread in the set-partitioned mode keeps a private block (including its
+ * own recency clock) that is merged at the end of the run.
+ */
+typedef struct simstats {
+    long hit;
+    long miss;
+    long eviction;
+    long dirtyInCache;
+    long dirtyEvicted;
+    long writeThrough; // blocks written through to memory
+    long time;
+} SimStats;
+
+// O(1) hit promotion/victim selection via recency lists is the default
+// above this associativity; below it the timestamp scan is already cheap
+#define LRU_LIST_THRESHOLD 8
+
+/** @brief Replacement policies selectable with -p */
+typedef enum {
+    REPL_LRU,   // exact LRU (timestamp scan or recency list)
+    REPL_PLRU,  // tree pseudo-LRU, one bit tree per set
+    REPL_SRRIP, // static RRIP, 2-bit re-reference predictions
+    REPL_BRRIP, // bimodal RRIP, mostly-distant insertion
+    REPL_RAND,  // xorshift random victim
+} ReplPolicy;
+
+/** @brief rrpv at which a line becomes a victim (2-bit RRIP) */
+#define RRIP_MAX 3
+
+/** @brief Write policies selectable with -w */
+typedef enum {
+    WP_WB_WA,  // write-back, write-allocate (default)
+    WP_WB_NWA, // write-back, no-write-allocate
+    WP_WT_WA,  // write-through, write-allocate
+    WP_WT_NWA, // write-through, no-write-allocate
+} WritePolicy;
+
+/** @brief One simulated cache instance.
+ *
+ * All simulation state lives here so several instances can run side by
+ * side (parameter sweeps, and eventually cache hierarchies): the flattened
+ * line array, the packed tags and valid bitmask for the match kernel, the
+ * per-set recency lists, and this instance's counters.
+ */
+typedef struct cachesim {
+    int s, b, E;      // configuration
+    int S, B;         // derived: number of sets, bytes per block
+    int maskWords;    // 64-bit words of validMask per set
+    int useRecencyList;
+    long *tagArr;             // flattened S*E tags, indexed by set*E + way
+    unsigned long *validMask; // one bit per line, maskWords words per set
+    unsigned long *dirtyMask; // same shape as validMask
+    unsigned long *pfMask;    // likewise; prefetched and not yet used
+    int *timeStamp;           // per-line recency clock (timestamp LRU)
+    int *lruPrev;             // per-line recency list links (list LRU)
+    int *lruNext;
+    int *lruHead;     // most recently used way of each set
+    int *lruTail;     // least recently used way of each set
+    ReplPolicy policy;
+    unsigned long *plruBits; // E-1 tree bits per set (PLRU only)
+    int plruWords;           // 64-bit words of plruBits per set
+    unsigned char *rrpv;     // per-line re-reference predictions (RRIP only)
+    unsigned long randState; // xorshift state (BRRIP/random)
+    WritePolicy wpolicy;
+    struct cachesim *next; // next cache level, or NULL for the last one
+    SimStats stats;
+} Cache;
+
+ReplPolicy defaultPolicy = REPL_LRU; // applied to every new instance (-p)
+WritePolicy defaultWritePolicy = WP_WB_WA; // likewise for -w
+
+Cache mainCache; // the first-level simulation target
+
+// sweep mode (-S): each decoded record is replayed into every instance
+Cache *sweepCaches = NULL;
+int nSweep = 0;
 
-Line **cache = NULL;
-int hit = 0, miss = 0, eviction = 0, dirtyInCache = 0, dirtyEvicted = 0,
-    time = 0, S, B, E;
+// hierarchy mode (-L): extra levels chained behind mainCache via ->next
+Cache *extraLevels = NULL;
+int nExtraLevels = 0;
+
+int haveAvx2 = 0;   // runtime dispatch for the vector match kernel
+int scalarMode = 0; // --scalar: force the naive reference paths
+
+/*
+ * Cycle-cost model (--cost).
+ *
+ * Every cost event is already counted during simulation: per-level hits,
+ * misses and dirty evictions, and the write-through traffic. Total
+ * cycles and AMAT are therefore derived exactly from those counters at
+ * report time: each level probe costs the hit latency, a last-level
+ * miss pays the memory latency, and the blocks the last level writes
+ * back or through pay the writeback latency.
+ */
+int costMode = 0;                 // --cost given
+static long costHit = HIT_CYCLES; // cycles per level probe
+static long costMiss = MISS_CYCLES; // cycles per memory fetch
+static long costWb = -1;            // cycles per written-back block,
+                                    // -1 defaults to the miss latency
 
 static void print_help() {
     printf("-h,  show this help message and exit\n");
@@ -28,10 +143,66 @@ static void print_help() {
     printf("-s <s>,  Number of set index bits (there are 2**s sets)\n");
     printf("-b <b>,  Number of block  bits (there are 2**b blocks)\n");
     printf("-E <E>,  Number of lines per set (associativity)\n");
+    printf("-j <n>,  Shard sets across <n> worker threads\n");
+    printf("-a,  Overlap trace parsing and simulation with a reader "
+           "thread\n");
+    printf("-p <policy>,  Replacement policy: lru (default), plru, srrip, "
+           "brrip, rand\n");
+    printf("-w <policy>,  Write policy: wb-wa (default), wb-nwa, wt-wa, "
+           "wt-nwa\n");
+    printf("-B,  Report per-phase timing and throughput after the "
+           "summary\n");
+    printf("-m,  Cache the parsed trace in shared memory across "
+           "invocations\n");
+    printf("-C <state>,  Save the final cache state and counters to "
+           "<state>\n");
+    printf("-R <state>,  Restore cache state from <state> before "
+           "replaying the trace\n");
     printf("-t <trace>,  File name of the memory trace to process\n");
+    printf("-T <trace>,  File name of a packed binary trace to process "
+           "(see tracepack)\n");
+    printf("-S <cfg>,  Sweep mode: replay the trace through every \"s E b\" "
+           "config listed in <cfg>\n");
+    printf("-M <manifest>,  Run every \"s E b trace\" job listed in "
+           "<manifest> on a thread pool\n");
+    printf("-L <s,E,b[:s,E,b...]>,  Chain extra cache levels behind the "
+           "-s/-E/-b level\n");
+    printf("--classify,  Split misses into compulsory, capacity and "
+           "conflict in the summary\n");
+    printf("--classify-log <file>,  Stream per-interval classified miss "
+           "counts to <file>\n");
+    printf("--classify-interval <n>,  Accesses per streamed row "
+           "(default 100000)\n");
+    printf("--verbose-log <file>,  Verbose mode writing binary event "
+           "records to <file>\n");
+    printf("--sample <1/n>,  Estimate the summary from the sets whose "
+           "index is a multiple of <n>\n");
+    printf("--sample-interval <n>,  Estimate from every --sample'th "
+           "window of <n> accesses\n");
+    printf("--sample-warmup <n>,  Warmup accesses per sampled window "
+           "(default 1/4 of the window)\n");
+    printf("--prefetch <next[:n]|stride>,  Run a prefetch engine ahead "
+           "of the demand stream\n");
+    printf("--interval <n>,  Stream per-interval counter deltas every <n> "
+           "accesses\n");
+    printf("--tlb <s,E[,p]>,  Translate addresses through a page table "
+           "and a 2**s-set, E-way TLB (2**p-byte pages, default 12)\n");
+    printf("--heatmap <file>,  Dump per-set access/miss/eviction counters "
+           "to <file> and list the most conflicted sets\n");
+    printf("--collapse,  Apply runs of identical block accesses in O(1) "
+           "on the plain LRU path (bit-identical results)\n");
+    printf("--scalar,  Force the naive reference paths (no SIMD, batch "
+           "kernels, recency lists or collapsing)\n");
+    printf("--cost,  Report total cycles and AMAT (hit %d, miss %d cycle "
+           "defaults)\n",
+           HIT_CYCLES, MISS_CYCLES);
+    printf("--cost-cycles <h,m[,w]>,  Cost model latencies: level probe, "
+           "memory fetch and writeback cycles\n");
+    printf("--interval-log <file>,  Interval reporting writing binary "
+           "rows to <file>\n");
     printf("\n");
-    printf("The -s, -b, -E and -t options must be supplied for all "
-           "simulations.\n");
+    printf("The -s, -b, -E and one of the -t/-T options must be supplied "
+           "for all simulations.\n");
 }
 
 /** Check if the command line input is valid.
@@ -53,42 +224,262 @@ static void checkValidInput(int s, int b, int E, char *t) {
     }
 }
 
-/** Initialize the params of the cache.
+/*
+ * Arena allocator for simulator state.
+ *
+ * A cache instance owns half a dozen arrays, and the sweep and hierarchy
+ * modes multiply that by the number of instances; glibc malloc scatters
+ * them across the heap, which costs first-touch page faults and TLB
+ * misses on large geometries. All fixed-size simulator state is instead
+ * bump-allocated from a few big anonymous mappings: instances end up
+ * adjacent and cache-line aligned, the kernel is asked to back the
+ * region with huge pages, and teardown is one munmap per chunk instead
+ * of one free per array. Growable structures (the sweep table, the
+ * distinct-block set) stay on malloc since the arena never frees.
+ */
+
+/** @brief Granularity of one arena mapping (a multiple of 2 MiB) */
+#define ARENA_CHUNK (64UL << 20)
+
+/** @brief Alignment of every arena allocation (one host cache line) */
+#define ARENA_ALIGN 64UL
+
+typedef struct arenachunk {
+    struct arenachunk *next; // previously mapped chunks
+    size_t size;             // bytes mapped, including this header
+} ArenaChunk;
+
+static ArenaChunk *arenaChunks = NULL;
+static unsigned char *arenaCur = NULL; // bump pointer in the newest chunk
+static size_t arenaLeft = 0;
+
+/** Map one fresh arena chunk.
+ *
+ * @param the number of bytes to map.
+ * @return the mapping, never NULL.
+ */
+static void *arena_map(size_t bytes) {
+    void *p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    // try reserved huge pages first; most boxes have none configured
+    p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (p == MAP_FAILED) {
+        p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (p == MAP_FAILED) {
+        printf("Failed to allocate memory.\n");
+        exit(1);
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+    return p;
+}
+
+/** Carve one zero-filled allocation out of the arena.
+ *
+ * @param the number of bytes needed.
+ * @return a cache-line aligned block; fresh mappings are already zero.
+ */
+static pthread_mutex_t arenaLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *arena_alloc(size_t bytes) {
+    // the job pool (-M) carves several instances concurrently
+    pthread_mutex_lock(&arenaLock);
+    bytes = (bytes + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if (bytes > arenaLeft) {
+        size_t header = (sizeof(ArenaChunk) + ARENA_ALIGN - 1) &
+                        ~(ARENA_ALIGN - 1);
+        size_t chunk = ARENA_CHUNK;
+        if (chunk < bytes + header) {
+            // oversize request: its own chunk, rounded to huge pages
+            chunk = (bytes + header + (2UL << 20) - 1) & ~((2UL << 20) - 1);
+        }
+        ArenaChunk *ck = (ArenaChunk *)arena_map(chunk);
+        ck->next = arenaChunks;
+        ck->size = chunk;
+        arenaChunks = ck;
+        arenaCur = (unsigned char *)ck + header;
+        arenaLeft = chunk - header;
+    }
+    void *p = arenaCur;
+    arenaCur += bytes;
+    arenaLeft -= bytes;
+    pthread_mutex_unlock(&arenaLock);
+    return p;
+}
+
+/** Return every arena chunk to the kernel.
+ *
+ * @param None.
+ * @return None.
+ */
+static void arena_release(void) {
+    while (arenaChunks) {
+        ArenaChunk *next = arenaChunks->next;
+        munmap(arenaChunks, arenaChunks->size);
+        arenaChunks = next;
+    }
+    arenaCur = NULL;
+    arenaLeft = 0;
+}
+
+/** Initialize one cache instance.
  *
- * @param set bits, block offset bits, number of lines per set.
+ * @param the instance, set bits, block offset bits, number of lines per set.
  * @return None.
  */
-void init_cache(int s, int b, int E) {
-    S = 1 << s;
-    B = 1 << b;
-    cache = (Line **)malloc(sizeof(Line *) * (unsigned long)S);
+void init_cache(Cache *c, int s, int b, int E) {
+    c->s = s;
+    c->b = b;
+    c->E = E;
+    c->S = 1 << s;
+    c->B = 1 << b;
+    c->next = NULL;
+    memset(&c->stats, 0, sizeof(c->stats));
+    int S = c->S;
 
-    // initializa every line
+    // per-line recency clocks and list links, indexed by set*E + way;
+    // arena memory arrives zero-filled, so the timestamps start at 0
+    c->timeStamp = (int *)arena_alloc(sizeof(int) * (unsigned long)S *
+                                      (unsigned long)E);
+    c->lruPrev = (int *)arena_alloc(sizeof(int) * (unsigned long)S *
+                                    (unsigned long)E);
+    c->lruNext = (int *)arena_alloc(sizeof(int) * (unsigned long)S *
+                                    (unsigned long)E);
+
+    // link every set's recency list in way order; untouched ways drain
+    // from the tail, touched ways are promoted to the head
+    c->useRecencyList = E > LRU_LIST_THRESHOLD && !scalarMode;
+    c->lruHead = (int *)arena_alloc(sizeof(int) * (unsigned long)S);
+    c->lruTail = (int *)arena_alloc(sizeof(int) * (unsigned long)S);
     for (int i = 0; i < S; i++) {
-        cache[i] = (Line *)malloc(sizeof(Line) * (unsigned long)E);
+        long base = (long)i * E;
         for (int j = 0; j < E; j++) {
-            cache[i][j].valid = 0;
-            cache[i][j].tag = 0;
-            cache[i][j].dirty = 0;
-            cache[i][j].timeStamp = 0;
+            c->lruPrev[base + j] = j - 1;
+            c->lruNext[base + j] = j + 1 < E ? j + 1 : -1;
+        }
+        c->lruHead[i] = 0;
+        c->lruTail[i] = E - 1;
+    }
+
+    // packed tag array and per-set valid, dirty and prefetch bitmasks
+    c->maskWords = (E + 63) / 64;
+    c->tagArr = (long *)arena_alloc(sizeof(long) * (unsigned long)S *
+                                    (unsigned long)E);
+    c->validMask = (unsigned long *)arena_alloc(
+        sizeof(unsigned long) * (unsigned long)S * (unsigned long)c->maskWords);
+    c->dirtyMask = (unsigned long *)arena_alloc(
+        sizeof(unsigned long) * (unsigned long)S * (unsigned long)c->maskWords);
+    c->pfMask = (unsigned long *)arena_alloc(
+        sizeof(unsigned long) * (unsigned long)S * (unsigned long)c->maskWords);
+
+    // replacement policy state
+    c->policy = defaultPolicy;
+    c->wpolicy = defaultWritePolicy;
+    c->plruBits = NULL;
+    c->plruWords = 0;
+    c->rrpv = NULL;
+    c->randState = 0x9e3779b97f4a7c15UL; // fixed seed keeps runs repeatable
+    if (c->policy == REPL_PLRU) {
+        if ((E & (E - 1)) != 0) {
+            printf("PLRU requires a power-of-two associativity\n");
+            exit(1);
         }
+        c->plruWords = (E - 1 + 63) / 64;
+        c->plruBits = (unsigned long *)arena_alloc(
+            sizeof(unsigned long) * (unsigned long)S *
+            (unsigned long)c->plruWords);
+    }
+    if (c->policy == REPL_SRRIP || c->policy == REPL_BRRIP) {
+        c->rrpv =
+            (unsigned char *)arena_alloc((unsigned long)S * (unsigned long)E);
+        memset(c->rrpv, RRIP_MAX, (unsigned long)S * (unsigned long)E);
     }
 }
 
-/** find the line matches with the address.
+/** Release the memory of one cache instance.
  *
- * @param tag bits, set index.
+ * Instance arrays live in the arena, which is returned to the kernel in
+ * one shot by arena_release(); nothing is freed per instance.
+ *
+ * @param the instance.
+ * @return None.
+ */
+void free_cache(Cache *c) {
+    (void)c;
+}
+
+/** Scalar tag search over the packed tag array of one set.
+ *
+ * @param packed tags and valid bitmask of the set, tag bits to match.
  * @return the line index of the matched line in the set, or -1 if no matched
  * line.
  */
-int find_matched_line(long tag, int setIndex) {
+static int match_tags_scalar(const long *tags, const unsigned long *valid,
+                             long tag, int E) {
     for (int i = 0; i < E; i++) {
-        if (cache[setIndex][i].valid == 1 && cache[setIndex][i].tag == tag) {
+        if ((valid[i >> 6] & (1UL << (i & 63))) && tags[i] == tag) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#if defined(__x86_64__)
+/** AVX2 tag search comparing four packed tags per instruction.
+ *
+ * @param packed tags and valid bitmask of the set, tag bits to match.
+ * @return the line index of the matched line in the set, or -1 if no matched
+ * line.
+ */
+__attribute__((target("avx2"))) static int
+match_tags_avx2(const long *tags, const unsigned long *valid, long tag,
+                int E) {
+    __m256i vtag = _mm256_set1_epi64x(tag);
+    int i = 0;
+    for (; i + 4 <= E; i += 4) {
+        __m256i vcmp = _mm256_cmpeq_epi64(
+            _mm256_loadu_si256((const __m256i *)(tags + i)), vtag);
+        unsigned mask = (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(vcmp));
+
+        // a matching tag only counts if its valid bit is set
+        while (mask) {
+            int j = i + __builtin_ctz(mask);
+            if (valid[j >> 6] & (1UL << (j & 63))) {
+                return j;
+            }
+            mask &= mask - 1;
+        }
+    }
+    for (; i < E; i++) {
+        if ((valid[i >> 6] & (1UL << (i & 63))) && tags[i] == tag) {
             return i;
         }
     }
     return -1;
 }
+#endif
+
+/** find the line matches with the address.
+ *
+ * @param tag bits, set index.
+ * @return the line index of the matched line in the set, or -1 if no matched
+ * line.
+ */
+int find_matched_line(const Cache *c, long tag, int setIndex) {
+    const long *tags = c->tagArr + (long)setIndex * c->E;
+    const unsigned long *valid = c->validMask + (long)setIndex * c->maskWords;
+#if defined(__x86_64__)
+    if (haveAvx2 && c->E >= 8) {
+        return match_tags_avx2(tags, valid, tag, c->E);
+    }
+#endif
+    return match_tags_scalar(tags, valid, tag, c->E);
+}
 
 /** find the first empty line in the set.
  *
@@ -96,238 +487,3524 @@ int find_matched_line(long tag, int setIndex) {
  * @return the line index of the first empty line in the set, or -1 if the set
  * is full.
  */
-int find_empty_line(int setIndex) {
-    for (int i = 0; i < E; i++) {
-        if (cache[setIndex][i].valid == 0) {
-            return i;
+int find_empty_line(const Cache *c, int setIndex) {
+    const unsigned long *valid = c->validMask + (long)setIndex * c->maskWords;
+    for (int w = 0; w < c->maskWords; w++) {
+        unsigned long empty = ~valid[w];
+        if (empty != 0) {
+            int i = w * 64 + __builtin_ctzl(empty);
+            return i < c->E ? i : -1;
         }
     }
     return -1;
 }
 
+/** Move a line to the head (most recently used end) of its set's
+ * recency list.
+ *
+ * @param set index, line index of the touched line.
+ * @return None.
+ */
+static void recency_touch(Cache *c, int setIndex, int lineIndex) {
+    if (c->lruHead[setIndex] == lineIndex) {
+        return;
+    }
+    long base = (long)setIndex * c->E;
+    int prev = c->lruPrev[base + lineIndex];
+    int next = c->lruNext[base + lineIndex];
+
+    // unlink from the current position
+    if (prev != -1) {
+        c->lruNext[base + prev] = next;
+    }
+    if (next != -1) {
+        c->lruPrev[base + next] = prev;
+    } else {
+        c->lruTail[setIndex] = prev;
+    }
+
+    // push at the head
+    c->lruPrev[base + lineIndex] = -1;
+    c->lruNext[base + lineIndex] = c->lruHead[setIndex];
+    c->lruPrev[base + c->lruHead[setIndex]] = lineIndex;
+    c->lruHead[setIndex] = lineIndex;
+}
+
 /** find the least recently used line in the set.
  *
  * @param set index.
  * @return the line index of LRU line.
  */
-int find_LRU(int setIndex) {
-    int minTime = 9999999, minIndex = -1;
-    for (int i = 0; i < E; i++) {
-        int time = cache[setIndex][i].timeStamp;
-        if (time < minTime) {
-            minTime = time;
+int find_LRU(const Cache *c, int setIndex) {
+    if (c->useRecencyList) {
+        return c->lruTail[setIndex];
+    }
+    // seed the scan from line 0: a fixed sentinel would underflow once
+    // every timestamp in the set passes it on a long enough trace
+    const int *times = c->timeStamp + (long)setIndex * c->E;
+    int minTime = times[0], minIndex = 0;
+    for (int i = 1; i < c->E; i++) {
+        if (times[i] < minTime) {
+            minTime = times[i];
             minIndex = i;
         }
     }
     return minIndex;
 }
 
-/** Set the line according to the address.
+void access_cache(Cache *c, SimStats *st, long tag, int setIndex,
+                  int isStore);
+
+/** Hand a block-aligned access down to the next cache level.
  *
- * @param tag bits, set index of the address, line index of the address.
+ * Demand misses propagate as loads and dirty writebacks as stores; the
+ * block address is rebuilt from this level's tag and set index before the
+ * next level re-decodes it with its own geometry.
+ *
+ * @param the originating level, operation, tag bits and set index.
  * @return None.
  */
-void set_cache(long tag, int setIndex, int lineIndex) {
-    cache[setIndex][lineIndex].valid = 1;
-    cache[setIndex][lineIndex].tag = tag;
-    cache[setIndex][lineIndex].dirty = 0;
-    cache[setIndex][lineIndex].timeStamp = time;
+static void propagate_next_level(Cache *c, char op, long tag, int setIndex) {
+    Cache *n = c->next;
+    unsigned long addr = ((unsigned long)tag << (unsigned int)(c->s + c->b)) |
+                         ((unsigned long)setIndex << (unsigned int)c->b);
+    long ntag = (long)(addr >> (unsigned int)(n->s + n->b));
+    int nsetIndex = (int)((addr & ((1UL << (unsigned int)(n->s + n->b)) - 1)) >>
+                          (unsigned int)n->b);
+    access_cache(n, &n->stats, ntag, nsetIndex, op == 'S');
 }
 
-/** Load the address into cache.
+/** Advance an xorshift64 generator.
  *
- * @param tag bits and set index of the address.
- * @return None.
+ * @param the generator state.
+ * @return the next value.
  */
-void load_cache(long tag, int setIndex) {
-    time++;
-    int lineIndex = find_matched_line(tag, setIndex);
+static unsigned long xorshift64(unsigned long *state) {
+    unsigned long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
 
-    // address results in a hit; update timestamp
-    if (lineIndex != -1) {
-        hit++;
-        cache[setIndex][lineIndex].timeStamp = time;
-    }
-    // address results in a miss; update line and timestamp
-    else {
-        miss++;
-        int newLineIndex = find_empty_line(setIndex);
+/** Point the PLRU tree bits of a set away from a touched way.
+ *
+ * @param the cache, set index, the way that was accessed.
+ * @return None.
+ */
+static void plru_touch(Cache *c, int setIndex, int way) {
+    unsigned long *bits = c->plruBits + (long)setIndex * c->plruWords;
+    int node = 1;
+    for (int span = c->E >> 1; span > 0; span >>= 1) {
+        int right = (way & span) != 0;
 
-        // no empty lines; evict a line by LRU
-        if (newLineIndex == -1) {
-            newLineIndex = find_LRU(setIndex);
-            if (cache[setIndex][newLineIndex].dirty == 1) {
-                dirtyEvicted++;
-                dirtyInCache--;
-            }
-            eviction++;
+        // bit set means the next victim lives in the right half, so the
+        // touched half flips the bit the other way
+        if (right) {
+            bits[(node - 1) >> 6] &= ~(1UL << ((node - 1) & 63));
+        } else {
+            bits[(node - 1) >> 6] |= 1UL << ((node - 1) & 63);
         }
-        set_cache(tag, setIndex, newLineIndex);
+        node = node * 2 + right;
     }
 }
 
-/** Store the address into cache.
+/** Walk the PLRU tree bits of a set down to the victim way.
  *
- * @param tag bits and set index of the address.
- * @return None.
+ * @param the cache, set index.
+ * @return the victim way.
  */
-void store_cache(long tag, int setIndex) {
-    time++;
-    int lineIndex = find_matched_line(tag, setIndex);
-
-    // address results in a hit; update timestamp
-    if (lineIndex != -1) {
-        hit++;
-        cache[setIndex][lineIndex].timeStamp = time;
-
-        // update the dirty bit
-        if (cache[setIndex][lineIndex].dirty == 0) {
-            dirtyInCache++;
-            cache[setIndex][lineIndex].dirty = 1;
+static int plru_victim(const Cache *c, int setIndex) {
+    const unsigned long *bits = c->plruBits + (long)setIndex * c->plruWords;
+    int node = 1, way = 0;
+    for (int span = c->E >> 1; span > 0; span >>= 1) {
+        int bit = (bits[(node - 1) >> 6] >> ((node - 1) & 63)) & 1;
+        if (bit) {
+            way |= span;
         }
+        node = node * 2 + bit;
     }
-    // address results in a miss; update line and timestamp
-    else {
-        miss++;
-        int newLineIndex = find_empty_line(setIndex);
-        // no empty lines; evict a line by LRU
-        if (newLineIndex == -1) {
-            newLineIndex = find_LRU(setIndex);
-            if (cache[setIndex][newLineIndex].dirty == 1) {
-                dirtyEvicted++;
+    return way;
+}
+
+/** Pick an RRIP victim, aging the set until one way is distant enough.
+ *
+ * @param the cache, set index.
+ * @return the victim way.
+ */
+static int rrip_victim(Cache *c, int setIndex) {
+    unsigned char *rrpv = c->rrpv + (long)setIndex * c->E;
+    for (;;) {
+        for (int i = 0; i < c->E; i++) {
+            if (rrpv[i] == RRIP_MAX) {
+                return i;
             }
-            eviction++;
         }
-
-        if (cache[setIndex][newLineIndex].dirty == 0) {
-            dirtyInCache++;
+        for (int i = 0; i < c->E; i++) {
+            rrpv[i]++;
         }
-        set_cache(tag, setIndex, newLineIndex);
-        cache[setIndex][newLineIndex].dirty = 1;
     }
 }
 
-/** Process a memory -access trace file.
+/** Pick the victim way of a set under the configured policy.
  *
- * @param trace Name of the trace file to process.
- * @return 0 if successful , 1 if there were errors.
+ * @param the cache, set index.
+ * @return the victim way.
  */
-int process_trace_file(const char *trace, int s, int E, int b) {
-    FILE *tfp = fopen(trace, "rt");
-    if (!tfp) {
-        fprintf(stderr, "Error opening'%s'\n", trace);
-        exit(1);
+int find_victim(Cache *c, int setIndex) {
+    switch (c->policy) {
+    case REPL_PLRU:
+        return plru_victim(c, setIndex);
+
+    case REPL_SRRIP:
+    case REPL_BRRIP:
+        return rrip_victim(c, setIndex);
+
+    case REPL_RAND:
+        return (int)(xorshift64(&c->randState) % (unsigned long)c->E);
+
+    case REPL_LRU:
+    default:
+        return find_LRU(c, setIndex);
     }
-    int size, parse_error = 0;
-    unsigned long addr;
-    char action;
+}
 
-    // scan each line in the trace, and act accordingly
-    while (fscanf(tfp, " %c %lx,%d", &action, &addr, &size) > 0) {
-        if (addr < 0) {
-            printf("Address %lu is out of range\n", addr);
-            exit(1);
-        }
-        if (size < 0 || size >= MAX_SIZE) {
-            printf("Size is out of range\n");
-            exit(1);
-        }
+/** Update replacement state for a touched line (hit or fill).
+ *
+ * @param the cache, its counter block, set index, line index, and whether
+ * the touch is a miss fill rather than a hit.
+ * @return None.
+ */
+static void policy_touch(Cache *c, SimStats *st, int setIndex, int lineIndex,
+                         int isFill) {
+    switch (c->policy) {
+    case REPL_PLRU:
+        plru_touch(c, setIndex, lineIndex);
+        break;
 
-        long tag = (long)(addr >> (unsigned int)(s + b));
-        int setIndex = (int)((addr & ((1 << (unsigned int)(s + b)) - 1)) >>
-                             (unsigned int)b);
+    case REPL_SRRIP:
+        c->rrpv[(long)setIndex * c->E + lineIndex] =
+            isFill ? RRIP_MAX - 1 : 0;
+        break;
 
-        switch (action) {
-        case 'L':
-            load_cache(tag, setIndex);
-            break;
+    case REPL_BRRIP:
+        // fills are inserted distant, occasionally one step closer
+        if (isFill) {
+            c->rrpv[(long)setIndex * c->E + lineIndex] =
+                (xorshift64(&c->randState) & 31) == 0 ? RRIP_MAX - 1
+                                                      : RRIP_MAX;
+        } else {
+            c->rrpv[(long)setIndex * c->E + lineIndex] = 0;
+        }
+        break;
 
-        case 'S':
-            store_cache(tag, setIndex);
-            break;
+    case REPL_RAND:
+        break;
 
-        default:
-            printf("Invalid action\n");
-            exit(1);
+    case REPL_LRU:
+    default:
+        c->timeStamp[(long)setIndex * c->E + lineIndex] = (int)st->time;
+        if (c->useRecencyList) {
+            recency_touch(c, setIndex, lineIndex);
         }
+        break;
     }
-    fclose(tfp);
-    return parse_error;
 }
 
-int main(int argc, char *argv[]) {
-    int opt, hflag = 0, vflag = 0, s = -1, b = -1;
-    char t[1000];
+/*
+ * Miss classification (--classify).
+ *
+ * Each L1 miss is tagged as compulsory, capacity or conflict: compulsory
+ * misses touch a block the run has never referenced, capacity misses
+ * would also miss in a fully-associative LRU cache of equal capacity,
+ * and the remainder are conflicts caused by the set mapping. The shadow
+ * fully-associative cache keeps exact recency order with an intrusive
+ * list and finds blocks through a linear-probing hash table, so each
+ * classified access costs O(1); the whole engine sits behind a single
+ * predictable branch, so the uninstrumented path keeps its speed.
+ */
 
-    // Parse the command line into options
-    while ((opt = getopt(argc, argv, "hvs:b:E:t:")) != -1) {
-        switch (opt) {
-        case 'h':
-            hflag = 1;
-            break;
+int classifyMode = 0; // --classify given
 
-        case 'v':
-            vflag = 1;
-            break;
+static FILE *classifyLog = NULL;       // --classify-log destination
+static long classifyInterval = 100000; // accesses per streamed row
 
-        case 's':
-            s = atoi(optarg);
-            break;
+// fully-associative shadow cache: block address, recency list and a
+// block -> node hash table (keys stored as block + 1, 0 marks empty)
+static int shadowLines;
+static long *shadowBlock;
+static int *shadowPrev;
+static int *shadowNext;
+static int shadowHead = -1, shadowTail = -1, shadowUsed;
+static long shadowMask;
+static long *shadowKey;
+static int *shadowSlot;
 
-        case 'b':
-            b = atoi(optarg);
-            break;
+// every block address the run has referenced, for compulsory misses
+static long seenMask;
+static long *seenKey;
+static long seenCount;
 
-        case 'E':
-            E = atoi(optarg);
-            break;
+static long classifyCompulsory, classifyCapacity, classifyConflict;
+static long classifyAccesses;
+static long lastCompulsory, lastCapacity, lastConflict; // streamed so far
 
-        case 't':
-            strcpy(t, optarg);
-            break;
+/** Mix a block address into a table index.
+ *
+ * @param the block address.
+ * @return a mixed 64-bit hash of the address.
+ */
+static inline long block_hash(long block) {
+    unsigned long x = (unsigned long)block;
+    x ^= x >> 33;
+    x *= 0x9e3779b97f4a7c15UL;
+    x ^= x >> 29;
+    return (long)x;
+}
 
-        default:
-            printf("Error while parsing arguments.\n");
+/** Record a block address in the distinct-block set.
+ *
+ * @param the block address.
+ * @return 1 if the block was never referenced before, 0 otherwise.
+ */
+static int seen_insert(long block) {
+    // grow at 3/4 load so probe chains stay short
+    if (seenCount * 4 >= (seenMask + 1) * 3) {
+        long oldSize = seenMask + 1;
+        long *oldKey = seenKey;
+        seenMask = oldSize * 2 - 1;
+        seenKey = (long *)calloc((unsigned long)(seenMask + 1), sizeof(long));
+        if (!seenKey) {
+            printf("Failed to allocate memory.\n");
             exit(1);
         }
+        for (long i = 0; i < oldSize; i++) {
+            if (oldKey[i] != 0) {
+                long j = block_hash(oldKey[i] - 1) & seenMask;
+                while (seenKey[j] != 0) {
+                    j = (j + 1) & seenMask;
+                }
+                seenKey[j] = oldKey[i];
+            }
+        }
+        free(oldKey);
     }
 
-    // detect whether arguments are not options or values for values
-    if (optind < argc) {
-        printf("Invalid input\n");
-        exit(1);
+    long key = block + 1;
+    long i = block_hash(block) & seenMask;
+    while (seenKey[i] != 0) {
+        if (seenKey[i] == key) {
+            return 0;
+        }
+        i = (i + 1) & seenMask;
     }
+    seenKey[i] = key;
+    seenCount++;
+    return 1;
+}
 
-    // if -h is given, print the help message
-    if (hflag) {
-        print_help();
-        return 0;
+/** Remove one entry from the shadow hash table.
+ *
+ * Linear probing cannot leave holes inside a probe chain, so entries
+ * after the vacated slot are shifted back while their home slot is not
+ * cyclically within the hole already closed.
+ *
+ * @param the table index of the entry to remove.
+ * @return None.
+ */
+static void shadow_table_erase(long i) {
+    long j = i;
+    for (;;) {
+        shadowKey[j] = 0;
+        long k = j;
+        for (;;) {
+            k = (k + 1) & shadowMask;
+            if (shadowKey[k] == 0) {
+                return;
+            }
+            long h = block_hash(shadowKey[k] - 1) & shadowMask;
+            // an entry may stay if its home slot lies in (j, k]
+            if (j <= k ? (j < h && h <= k) : (j < h || h <= k)) {
+                continue;
+            }
+            break;
+        }
+        shadowKey[j] = shadowKey[k];
+        shadowSlot[j] = shadowSlot[k];
+        j = k;
     }
+}
 
-    // if -v is given, verbose mode is on
-    if (vflag) {
-        printf("verbose mode on\n");
+/** Unlink one node from the shadow recency list.
+ *
+ * @param the shadow node.
+ * @return None.
+ */
+static void shadow_unlink(int n) {
+    if (shadowPrev[n] != -1) {
+        shadowNext[shadowPrev[n]] = shadowNext[n];
+    } else {
+        shadowHead = shadowNext[n];
+    }
+    if (shadowNext[n] != -1) {
+        shadowPrev[shadowNext[n]] = shadowPrev[n];
+    } else {
+        shadowTail = shadowPrev[n];
     }
+}
 
-    checkValidInput(s, b, E, t);
-    init_cache(s, b, E);
-    printf("s=%i, E=%i, b=%i\n", s, E, b);
-    process_trace_file(t, s, E, b);
+/** Push one node at the head of the shadow recency list.
+ *
+ * @param the shadow node.
+ * @return None.
+ */
+static void shadow_push_head(int n) {
+    shadowPrev[n] = -1;
+    shadowNext[n] = shadowHead;
+    if (shadowHead != -1) {
+        shadowPrev[shadowHead] = n;
+    }
+    shadowHead = n;
+    if (shadowTail == -1) {
+        shadowTail = n;
+    }
+}
 
-    // print the result
-    csim_stats_t *stats = malloc(sizeof(csim_stats_t));
-    stats->hits = (unsigned long)hit;
-    stats->misses = (unsigned long)miss;
-    stats->evictions = (unsigned long)eviction;
-    stats->dirty_bytes = (unsigned long)(dirtyInCache * B);
-    stats->dirty_evictions = (unsigned long)(dirtyEvicted * B);
-    printSummary(stats);
+/** Apply one access to the fully-associative shadow cache.
+ *
+ * @param the block address.
+ * @return 1 on a shadow hit, 0 on a shadow miss.
+ */
+static int shadow_access(long block) {
+    long key = block + 1;
+    long i = block_hash(block) & shadowMask;
+    while (shadowKey[i] != 0) {
+        if (shadowKey[i] == key) {
+            int n = shadowSlot[i];
+            shadow_unlink(n);
+            shadow_push_head(n);
+            return 1;
+        }
+        i = (i + 1) & shadowMask;
+    }
 
-    // free memory
-    for (int i = 0; i < S; i++) {
-        free(cache[i]);
+    // shadow miss: fill a fresh node, or recycle the least recent one
+    int n;
+    if (shadowUsed < shadowLines) {
+        n = shadowUsed++;
+    } else {
+        n = shadowTail;
+        shadow_unlink(n);
+        long victimKey = shadowBlock[n] + 1;
+        long v = block_hash(shadowBlock[n]) & shadowMask;
+        while (shadowKey[v] != victimKey) {
+            v = (v + 1) & shadowMask;
+        }
+        shadow_table_erase(v);
+    }
+    shadowBlock[n] = block;
+    shadow_push_head(n);
+
+    // the erase may have shifted entries, so probe again for a free slot
+    long j = block_hash(block) & shadowMask;
+    while (shadowKey[j] != 0) {
+        j = (j + 1) & shadowMask;
+    }
+    shadowKey[j] = key;
+    shadowSlot[j] = n;
+    return 0;
+}
+
+/** Allocate the shadow structures for one cache geometry.
+ *
+ * @param the cache whose capacity the shadow mirrors.
+ * @return None.
+ */
+static void classify_init(const Cache *c) {
+    shadowLines = (int)((long)c->S * c->E);
+
+    long tableSize = 16;
+    while (tableSize < 2L * shadowLines) {
+        tableSize *= 2;
+    }
+    shadowMask = tableSize - 1;
+
+    // the shadow arrays are fixed for the run, so they come from the
+    // arena; the distinct-block set rehashes and stays on malloc
+    shadowBlock = (long *)arena_alloc(sizeof(long) * (unsigned long)shadowLines);
+    shadowPrev = (int *)arena_alloc(sizeof(int) * (unsigned long)shadowLines);
+    shadowNext = (int *)arena_alloc(sizeof(int) * (unsigned long)shadowLines);
+    shadowKey = (long *)arena_alloc(sizeof(long) * (unsigned long)tableSize);
+    shadowSlot = (int *)arena_alloc(sizeof(int) * (unsigned long)tableSize);
+    seenMask = 1023;
+    seenKey = (long *)calloc((unsigned long)(seenMask + 1), sizeof(long));
+    if (!seenKey) {
+        printf("Failed to allocate memory.\n");
+        exit(1);
+    }
+}
+
+/** Release the shadow structures.
+ *
+ * @param None.
+ * @return None.
+ */
+static void free_classify(void) {
+    free(seenKey);
+}
+
+/** Classify one L1 reference against the shadow structures.
+ *
+ * @param the block address and whether the real cache missed.
+ * @return None.
+ */
+static void classify_access(long block, int missed) {
+    int firstTouch = seen_insert(block);
+    int shadowHit = shadow_access(block);
+
+    if (missed) {
+        if (firstTouch) {
+            classifyCompulsory++;
+        } else if (!shadowHit) {
+            classifyCapacity++;
+        } else {
+            classifyConflict++;
+        }
+    }
+
+    // stream one row of per-interval classified counts
+    classifyAccesses++;
+    if (classifyLog && classifyAccesses % classifyInterval == 0) {
+        fprintf(classifyLog, "%ld %ld %ld %ld\n", classifyAccesses,
+                classifyCompulsory - lastCompulsory,
+                classifyCapacity - lastCapacity,
+                classifyConflict - lastConflict);
+        lastCompulsory = classifyCompulsory;
+        lastCapacity = classifyCapacity;
+        lastConflict = classifyConflict;
+    }
+}
+
+/*
+ * Verbose per-access reporting (-v).
+ *
+ * Every access is reported with its operation, address, size and
+ * outcome (hit, miss, eviction, dirty writeback). Lines are formatted
+ * by hand into a large user-space buffer that is drained with one
+ * write() per megabyte, because per-line stdio makes verbose runs an
+ * order of magnitude slower than silent ones. --verbose-log switches to
+ * a fixed 16-byte binary event record per access, drained the same way,
+ * for traces too big to eyeball.
+ */
+
+/** @brief Outcome bits of one access */
+#define VERB_HIT 1u
+#define VERB_EVICT 2u
+#define VERB_DIRTY 4u
+
+int verboseMode = 0; // -v given
+
+static int verbFlags; // outcome of the access in flight
+
+/** @brief One record of the binary event log */
+typedef struct {
+    unsigned long addr; // byte address of the access
+    unsigned short size;
+    unsigned char op; // 'L' or 'S'
+    unsigned char flags;
+    unsigned int pad;
+} VerboseEvent;
+
+/** @brief Bytes of formatted text drained per write() */
+#define VERB_BUFLEN (1 << 20)
+
+/** @brief Binary events drained per write() */
+#define VERB_EVLEN 65536
+
+static char verbBuf[VERB_BUFLEN];
+static size_t verbUsed;
+static VerboseEvent verbEvents[VERB_EVLEN];
+static size_t verbEventUsed;
+static int verbBinary = 0; // --verbose-log given
+static int verbFd = 1;     // stdout, or the --verbose-log file
+
+/** Drain whichever verbose buffer is in use with a single write().
+ *
+ * @param None.
+ * @return None.
+ */
+static void verbose_flush(void) {
+    const char *p = verbBinary ? (const char *)verbEvents : verbBuf;
+    size_t left = verbBinary ? verbEventUsed * sizeof(VerboseEvent) : verbUsed;
+    while (left > 0) {
+        ssize_t put = write(verbFd, p, left);
+        if (put <= 0) {
+            printf("Failed to write verbose output.\n");
+            exit(1);
+        }
+        p += put;
+        left -= (size_t)put;
+    }
+    verbUsed = 0;
+    verbEventUsed = 0;
+}
+
+/** Append one access outcome to the verbose buffer.
+ *
+ * @param operation, byte address, access size and outcome bits.
+ * @return None.
+ */
+static void verbose_record(char action, unsigned long addr, int size,
+                           int flags) {
+    if (verbBinary) {
+        VerboseEvent *ev = &verbEvents[verbEventUsed];
+        ev->addr = addr;
+        ev->size = (unsigned short)size;
+        ev->op = (unsigned char)action;
+        ev->flags = (unsigned char)flags;
+        ev->pad = 0;
+        if (++verbEventUsed == VERB_EVLEN) {
+            verbose_flush();
+        }
+        return;
+    }
+
+    // the longest line is well under 64 bytes
+    if (verbUsed + 64 > VERB_BUFLEN) {
+        verbose_flush();
+    }
+    char *p = verbBuf + verbUsed;
+    *p++ = action;
+    *p++ = ' ';
+
+    // hex address, matching the trace format
+    int shift = 60;
+    while (shift > 0 && (addr >> shift) == 0) {
+        shift -= 4;
+    }
+    for (; shift >= 0; shift -= 4) {
+        *p++ = "0123456789abcdef"[(addr >> shift) & 0xf];
+    }
+    *p++ = ',';
+    if (size >= 10) {
+        *p++ = (char)('0' + size / 10);
+    }
+    *p++ = (char)('0' + size % 10);
+
+    if (flags & VERB_HIT) {
+        memcpy(p, " hit", 4);
+        p += 4;
+    } else {
+        memcpy(p, " miss", 5);
+        p += 5;
+    }
+    if (flags & VERB_EVICT) {
+        memcpy(p, " eviction", 9);
+        p += 9;
+    }
+    if (flags & VERB_DIRTY) {
+        memcpy(p, " dirty", 6);
+        p += 6;
+    }
+    *p++ = '\n';
+    verbUsed = (size_t)(p - verbBuf);
+}
+
+/** Set the line according to the address.
+ *
+ * @param tag bits, set index of the address, line index of the address.
+ * @return None.
+ */
+void set_cache(Cache *c, SimStats *st, long tag, int setIndex,
+               int lineIndex) {
+    long word = (long)setIndex * c->maskWords + (lineIndex >> 6);
+    unsigned long bit = 1UL << (lineIndex & 63);
+
+    c->tagArr[(long)setIndex * c->E + lineIndex] = tag;
+    c->timeStamp[(long)setIndex * c->E + lineIndex] = (int)st->time;
+    c->validMask[word] |= bit;
+    c->dirtyMask[word] &= ~bit;
+    c->pfMask[word] &= ~bit;
+
+    policy_touch(c, st, setIndex, lineIndex, 1);
+}
+
+/*
+ * Prefetcher models (--prefetch).
+ *
+ * A configurable engine runs ahead of the demand stream and issues
+ * block fills into the first-level cache: next-N-line prefetches the
+ * blocks after every demand miss, and the stride model keeps a small
+ * PC-less reference-prediction table indexed by 4 KiB page that issues
+ * a fill once the same stride repeats within a page. Issued prefetches
+ * sit in a pending queue for one demand access before they fill, which
+ * is what makes "late" observable: a demand miss on a block whose
+ * prefetch is still pending. Filled lines carry a bit until first use,
+ * so hits on them count as useful and evictions of untouched ones as
+ * useless.
+ */
+
+#define PREFETCH_NEXT 1
+#define PREFETCH_STRIDE 2
+
+int prefetchMode = 0;    // --prefetch given
+static int pfDegree = 1; // blocks fetched per next-line trigger
+
+static long pfIssued, pfUseful, pfUseless, pfLate;
+
+/** @brief In-flight prefetches, filled one demand access after issue */
+#define PF_PENDING 8
+
+static long pfPending[PF_PENDING];
+static int pfPendingLen;
+
+/** @brief Entries of the stride reference-prediction table */
+#define RPT_SIZE 256
+
+typedef struct {
+    unsigned long page; // 4 KiB page the entry tracks
+    long lastBlock;
+    long stride; // in blocks
+    int conf;    // saturating confidence, predicts at >= 2
+} RptEntry;
+
+static RptEntry rpt[RPT_SIZE];
+
+/** Queue one block for prefetching.
+ *
+ * @param the block address.
+ * @return None.
+ */
+static void prefetch_issue(long block) {
+    if (pfPendingLen == PF_PENDING) {
+        return;
+    }
+    pfPending[pfPendingLen++] = block;
+    pfIssued++;
+}
+
+/** Fill one prefetched block into the first-level cache.
+ *
+ * The fill follows the demand miss path -- eviction, dirty writeback
+ * and next-level accounting included -- but touches neither the hit nor
+ * the miss counter, and marks the line until its first demand use.
+ *
+ * @param the block address.
+ * @return None.
+ */
+static void prefetch_fill(long block) {
+    Cache *c = &mainCache;
+    long tag = block >> (unsigned int)c->s;
+    int setIndex = (int)(block & (long)(c->S - 1));
+    if (find_matched_line(c, tag, setIndex) != -1) {
+        return; // already cached, nothing to fetch
+    }
+
+    SimStats *st = &c->stats;
+    st->time++;
+    int victimDirty = 0;
+    long victimTag = 0;
+    int newLineIndex = find_empty_line(c, setIndex);
+    if (newLineIndex == -1) {
+        newLineIndex = find_victim(c, setIndex);
+        long word = (long)setIndex * c->maskWords + (newLineIndex >> 6);
+        unsigned long bit = 1UL << (newLineIndex & 63);
+        if (c->pfMask[word] & bit) {
+            pfUseless++; // evicted before any demand use
+        }
+        if (c->dirtyMask[word] & bit) {
+            st->dirtyEvicted++;
+            st->dirtyInCache--;
+            victimTag = c->tagArr[(long)setIndex * c->E + newLineIndex];
+            victimDirty = 1;
+        }
+        st->eviction++;
+    }
+    set_cache(c, st, tag, setIndex, newLineIndex);
+    c->pfMask[(long)setIndex * c->maskWords + (newLineIndex >> 6)] |=
+        1UL << (newLineIndex & 63);
+
+    if (c->next) {
+        propagate_next_level(c, 'L', tag, setIndex);
+        if (victimDirty) {
+            propagate_next_level(c, 'S', victimTag, setIndex);
+        }
+    }
+}
+
+/** Land the pending prefetches ahead of one demand access.
+ *
+ * @param the block address the demand access is about to reference.
+ * @return None.
+ */
+static void prefetch_drain(long demandBlock) {
+    for (int i = 0; i < pfPendingLen; i++) {
+        if (pfPending[i] == demandBlock) {
+            // issued, but not in time for this reference
+            long tag = demandBlock >> (unsigned int)mainCache.s;
+            int setIndex = (int)(demandBlock & (long)(mainCache.S - 1));
+            if (find_matched_line(&mainCache, tag, setIndex) == -1) {
+                pfLate++;
+            }
+        } else {
+            prefetch_fill(pfPending[i]);
+        }
+    }
+    pfPendingLen = 0;
+}
+
+/** Train the engine on one finished demand access.
+ *
+ * @param the block address and whether the demand access missed.
+ * @return None.
+ */
+static void prefetch_train(long block, int missed) {
+    if (prefetchMode == PREFETCH_NEXT) {
+        if (missed) {
+            for (int i = 1; i <= pfDegree; i++) {
+                prefetch_issue(block + i);
+            }
+        }
+        return;
+    }
+
+    // stride: track the last block and stride per 4 KiB page
+    unsigned long page =
+        ((unsigned long)block << (unsigned int)mainCache.b) >> 12;
+    RptEntry *e = &rpt[block_hash((long)page) & (RPT_SIZE - 1)];
+    if (e->page != page) {
+        e->page = page;
+        e->lastBlock = block;
+        e->stride = 0;
+        e->conf = 0;
+        return;
+    }
+    long delta = block - e->lastBlock;
+    if (delta == 0) {
+        return;
+    }
+    if (delta == e->stride) {
+        if (e->conf < 3) {
+            e->conf++;
+        }
+    } else if (e->conf > 1) {
+        e->conf--;
+    } else {
+        e->stride = delta;
+        e->conf = 1;
+    }
+    e->lastBlock = block;
+    if (e->conf >= 2) {
+        prefetch_issue(block + e->stride);
+    }
+}
+
+/*
+ * Per-set hot-set profiling (--heatmap).
+ *
+ * A global summary cannot show which sets a bad configuration is
+ * thrashing. With --heatmap the accesses, misses and evictions of every
+ * set are accumulated in a contiguous counter array indexed by set
+ * index, kept apart from the line metadata so the simulation loops do
+ * not drag the counters through the cache when the feature is off. The
+ * whole array is dumped to the given file at the end of the run and the
+ * most conflicted sets are appended to the summary. Sets are
+ * worker-private under -j, so the increments stay race-free.
+ */
+
+int heatmapMode = 0; // --heatmap given
+
+typedef struct {
+    long access, miss, eviction;
+} SetStats;
+
+static SetStats *setStats;
+
+/** Allocate the per-set counter array.
+ *
+ * @param None.
+ * @return None.
+ */
+static void heatmap_init(void) {
+    setStats = (SetStats *)calloc((unsigned long)mainCache.S,
+                                  sizeof(SetStats));
+    if (!setStats) {
+        printf("Failed to allocate memory.\n");
+        exit(1);
+    }
+}
+
+/** Dump the raw per-set counters to the heatmap file.
+ *
+ * The file holds S records of three longs: accesses, misses and
+ * evictions of set 0..S-1.
+ *
+ * @param the output file name.
+ * @return None.
+ */
+static void heatmap_dump(const char *file) {
+    FILE *fp = fopen(file, "wb");
+    if (!fp) {
+        printf("Failed to open the heatmap file.\n");
+        exit(1);
+    }
+    if (fwrite(setStats, sizeof(SetStats), (unsigned long)mainCache.S, fp) !=
+        (unsigned long)mainCache.S) {
+        printf("Failed to write the heatmap file.\n");
+        exit(1);
+    }
+    fclose(fp);
+}
+
+/** @brief Conflicted sets listed after the summary */
+#define HEATMAP_TOP 8
+
+/** Print the most conflicted sets, by evictions then misses.
+ *
+ * @param None.
+ * @return None.
+ */
+static void heatmap_report(void) {
+    int shown = mainCache.S < HEATMAP_TOP ? mainCache.S : HEATMAP_TOP;
+    unsigned char *taken =
+        (unsigned char *)calloc((unsigned long)mainCache.S, 1);
+    if (!taken) {
+        printf("Failed to allocate memory.\n");
+        exit(1);
+    }
+    for (int k = 0; k < shown; k++) {
+        int best = -1;
+        for (int i = 0; i < mainCache.S; i++) {
+            if (taken[i] || setStats[i].access == 0) {
+                continue;
+            }
+            if (best == -1 ||
+                setStats[i].eviction > setStats[best].eviction ||
+                (setStats[i].eviction == setStats[best].eviction &&
+                 setStats[i].miss > setStats[best].miss)) {
+                best = i;
+            }
+        }
+        if (best == -1) {
+            break;
+        }
+        taken[best] = 1;
+        printf("hotset: set=%d accesses=%ld misses=%ld evictions=%ld\n",
+               best, setStats[best].access, setStats[best].miss,
+               setStats[best].eviction);
+    }
+    free(taken);
+}
+
+/** Apply one access to the cache.
+ *
+ * Loads and stores share the same lookup, fill and eviction path; the
+ * store-specific work is a data-driven dirty-bit update instead of a
+ * separate function, which keeps the hot loop free of a second copy of
+ * the hit/miss logic.
+ *
+ * @param the cache, its counter block, tag bits and set index of the
+ * address, and 1 for a store, 0 for a load.
+ * @return None.
+ */
+void access_cache(Cache *c, SimStats *st, long tag, int setIndex,
+                  int isStore) {
+    // land the in-flight prefetches; a pending block this access wants
+    // counts as late and is left to the demand path
+    if (prefetchMode && c == &mainCache) {
+        prefetch_drain((tag << (unsigned int)c->s) | setIndex);
+    }
+    st->time++;
+    long heatMiss = 0, heatEvict = 0;
+    if (heatmapMode && c == &mainCache) {
+        heatMiss = st->miss;
+        heatEvict = st->eviction;
+    }
+    int lineIndex = find_matched_line(c, tag, setIndex);
+
+    // classify the L1 reference against the shadow structures (opt-in)
+    if (classifyMode && c == &mainCache) {
+        classify_access((tag << (unsigned int)c->s) | setIndex,
+                        lineIndex == -1);
+    }
+
+    // address results in a hit; update replacement state and dirty bit
+    if (lineIndex != -1) {
+        st->hit++;
+        if (verboseMode && c == &mainCache) {
+            verbFlags = VERB_HIT;
+        }
+        policy_touch(c, st, setIndex, lineIndex, 0);
+        long word = (long)setIndex * c->maskWords + (lineIndex >> 6);
+        unsigned long bit = 1UL << (lineIndex & 63);
+        if (c->wpolicy == WP_WT_WA || c->wpolicy == WP_WT_NWA) {
+            // write-through: the store goes to memory, the line stays clean
+            st->writeThrough += isStore;
+            if (isStore && c->next) {
+                propagate_next_level(c, 'S', tag, setIndex);
+            }
+        } else {
+            st->dirtyInCache += isStore & ((c->dirtyMask[word] & bit) == 0);
+            c->dirtyMask[word] |= bit * (unsigned long)isStore;
+        }
+        if (prefetchMode && c == &mainCache && (c->pfMask[word] & bit)) {
+            pfUseful++; // first demand use of a prefetched line
+            c->pfMask[word] &= ~bit;
+        }
+    }
+    // no-allocate store miss: the store goes straight to memory, and
+    // the whole fill and victim machinery is skipped
+    else if (isStore &&
+             (c->wpolicy == WP_WB_NWA || c->wpolicy == WP_WT_NWA)) {
+        st->miss++;
+        st->writeThrough++;
+        if (verboseMode && c == &mainCache) {
+            verbFlags = 0;
+        }
+        if (c->next) {
+            propagate_next_level(c, 'S', tag, setIndex);
+        }
+    }
+    // address results in a miss; fill a line, evicting if necessary
+    else {
+        st->miss++;
+        long victimTag = 0;
+        int victimDirty = 0;
+        int evicted = 0;
+        int newLineIndex = find_empty_line(c, setIndex);
+
+        // no empty lines; evict a line chosen by the policy
+        if (newLineIndex == -1) {
+            newLineIndex = find_victim(c, setIndex);
+            long word = (long)setIndex * c->maskWords + (newLineIndex >> 6);
+            unsigned long bit = 1UL << (newLineIndex & 63);
+            if (prefetchMode && c == &mainCache && (c->pfMask[word] & bit)) {
+                pfUseless++; // evicted before any demand use
+            }
+            if (c->dirtyMask[word] & bit) {
+                st->dirtyEvicted++;
+                st->dirtyInCache--;
+                victimTag = c->tagArr[(long)setIndex * c->E + newLineIndex];
+                victimDirty = 1;
+            }
+            st->eviction++;
+            evicted = 1;
+        }
+        if (verboseMode && c == &mainCache) {
+            verbFlags = (evicted ? VERB_EVICT : 0) |
+                        (victimDirty ? VERB_DIRTY : 0);
+        }
+        set_cache(c, st, tag, setIndex, newLineIndex);
+        if (c->wpolicy == WP_WT_WA) {
+            // the allocated line stays clean; the store went to memory
+            st->writeThrough += isStore;
+        } else {
+            st->dirtyInCache += isStore;
+            c->dirtyMask[(long)setIndex * c->maskWords + (newLineIndex >> 6)] |=
+                (1UL << (newLineIndex & 63)) * (unsigned long)isStore;
+        }
+
+        // the demand fetch, any dirty writeback and any written-through
+        // store reach the next level
+        if (c->next) {
+            propagate_next_level(c, 'L', tag, setIndex);
+            if (victimDirty) {
+                propagate_next_level(c, 'S', victimTag, setIndex);
+            }
+            if (isStore && c->wpolicy == WP_WT_WA) {
+                propagate_next_level(c, 'S', tag, setIndex);
+            }
+        }
+    }
+
+    // accumulate the per-set heat counters (opt-in)
+    if (heatmapMode && c == &mainCache) {
+        SetStats *h = &setStats[setIndex];
+        h->access++;
+        h->miss += st->miss - heatMiss;
+        h->eviction += st->eviction - heatEvict;
+    }
+
+    // let the engine observe the finished access and run ahead of it
+    if (prefetchMode && c == &mainCache) {
+        prefetch_train((tag << (unsigned int)c->s) | setIndex,
+                       lineIndex == -1);
+    }
+}
+
+/** Decode an address for one cache instance and replay the access.
+ *
+ * @param the instance, its counter block, operation and address.
+ * @return None.
+ */
+static void cache_access(Cache *c, SimStats *st, char op, unsigned long addr) {
+    long tag = (long)(addr >> (unsigned int)(c->s + c->b));
+    int setIndex = (int)((addr & ((1UL << (unsigned int)(c->s + c->b)) - 1)) >>
+                         (unsigned int)c->b);
+    access_cache(c, st, tag, setIndex, op == 'S');
+}
+
+/*
+ * Sampling-based simulation (--sample).
+ *
+ * For hit-rate estimates on huge traces, only a 1/N subset of the
+ * accesses is simulated and the reported counters are scaled by the
+ * inverse of the fraction actually measured. Set sampling simulates
+ * every access whose set index is a multiple of N, which keeps each
+ * simulated set exact. The interval variant (--sample-interval)
+ * simulates every N-th window of accesses against the full cache and
+ * treats the first part of each window as warmup: those accesses update
+ * the cache state so the window does not start cold, but are excluded
+ * from the measured counters.
+ */
+
+int sampleMode = 0;             // --sample or --sample-interval given
+static long sampleRate = 64;    // simulate 1/sampleRate of the trace
+static long sampleInterval = 0; // accesses per window, 0 for set sampling
+static long sampleWarmup = -1;  // warmup accesses per window, -1 for 1/4
+
+static long sampleTotal;   // accesses seen
+static long sampleCounted; // accesses measured
+static int sampleMeasuring;
+static SimStats sampleBase; // counters at the current measurement start
+static SimStats sampleAcc;  // measured deltas accumulated so far
+
+/** Accumulate the counter deltas of one finished measurement phase.
+ *
+ * @param None.
+ * @return None.
+ */
+static void sample_close_phase(void) {
+    sampleAcc.hit += mainCache.stats.hit - sampleBase.hit;
+    sampleAcc.miss += mainCache.stats.miss - sampleBase.miss;
+    sampleAcc.eviction += mainCache.stats.eviction - sampleBase.eviction;
+    sampleAcc.dirtyEvicted +=
+        mainCache.stats.dirtyEvicted - sampleBase.dirtyEvicted;
+    sampleMeasuring = 0;
+}
+
+/** Apply one access under the sampling policy.
+ *
+ * @param operation and byte address of the record.
+ * @return None.
+ */
+static void sample_access(char action, unsigned long addr) {
+    long idx = sampleTotal++;
+
+    // interval sampling: simulate every sampleRate-th window in full
+    if (sampleInterval > 0) {
+        long pos = idx % (sampleInterval * sampleRate);
+        if (pos >= sampleInterval) {
+            return;
+        }
+        if (pos < sampleWarmup) {
+            // warmup: update state, keep the access out of the counters
+            if (sampleMeasuring) {
+                sample_close_phase();
+            }
+        } else {
+            if (!sampleMeasuring) {
+                sampleBase = mainCache.stats;
+                sampleMeasuring = 1;
+            }
+            sampleCounted++;
+        }
+        cache_access(&mainCache, &mainCache.stats, action, addr);
+        return;
+    }
+
+    // set sampling: simulate the sets whose index is a multiple of the
+    // sampling rate, which keeps those sets exact
+    int setIndex =
+        (int)((addr >> (unsigned int)mainCache.b) & (unsigned long)(mainCache.S - 1));
+    if (setIndex % sampleRate != 0) {
+        return;
+    }
+    if (!sampleMeasuring) {
+        sampleBase = mainCache.stats;
+        sampleMeasuring = 1;
+    }
+    sampleCounted++;
+    cache_access(&mainCache, &mainCache.stats, action, addr);
+}
+
+/** Scale the measured counters up to a whole-trace estimate.
+ *
+ * @param the output statistics block to overwrite.
+ * @return None.
+ */
+static void sample_finish(csim_stats_t *stats) {
+    if (sampleMeasuring) {
+        sample_close_phase();
+    }
+    double scale =
+        sampleCounted > 0 ? (double)sampleTotal / (double)sampleCounted : 0;
+    stats->hits = (unsigned long)((double)sampleAcc.hit * scale + 0.5);
+    stats->misses = (unsigned long)((double)sampleAcc.miss * scale + 0.5);
+    stats->evictions =
+        (unsigned long)((double)sampleAcc.eviction * scale + 0.5);
+    stats->dirty_evictions = (unsigned long)(
+        (double)(sampleAcc.dirtyEvicted * mainCache.B) * scale + 0.5);
+
+    // end-state dirty bytes: sampled sets extrapolate to all sets, while
+    // interval sampling already runs the full-size cache
+    if (sampleInterval > 0) {
+        stats->dirty_bytes =
+            (unsigned long)(mainCache.stats.dirtyInCache * mainCache.B);
+    } else {
+        stats->dirty_bytes =
+            (unsigned long)(mainCache.stats.dirtyInCache * mainCache.B *
+                            sampleRate);
+    }
+}
+
+/*
+ * Address translation and TLB simulation (--tlb).
+ *
+ * Traces carry virtual addresses, but a physically-indexed cache wants
+ * physical ones. With --tlb each record is translated through a
+ * demand-populated page table before its tag and set index are
+ * extracted: frames are handed out sequentially on first touch, which
+ * keeps the mapping deterministic without rewriting the trace on disk.
+ * The TLB itself is one more Cache instance whose block bits are the
+ * page bits, so the lookup reuses the set-associative machinery and
+ * replacement policy of the main cache.
+ */
+
+int tlbMode = 0;             // --tlb given
+static int tlbPageBits = 12; // log2 of the page size
+static Cache tlbCache;
+
+// demand page table: VPN -> PFN hash map (keys stored as vpn + 1)
+static long pageMask;
+static long *pageKey;
+static long *pageVal;
+static long pageCount;
+static long nextFrame;
+
+/** Look up the frame of a virtual page, allocating on first touch.
+ *
+ * @param the virtual page number.
+ * @return the physical frame number.
+ */
+static long page_lookup(long vpn) {
+    // grow at 3/4 load so probe chains stay short
+    if (pageCount * 4 >= (pageMask + 1) * 3) {
+        long oldSize = pageMask + 1;
+        long *oldKey = pageKey;
+        long *oldVal = pageVal;
+        pageMask = oldSize * 2 - 1;
+        pageKey = (long *)calloc((unsigned long)(pageMask + 1), sizeof(long));
+        pageVal = (long *)calloc((unsigned long)(pageMask + 1), sizeof(long));
+        if (!pageKey || !pageVal) {
+            printf("Failed to allocate memory.\n");
+            exit(1);
+        }
+        for (long i = 0; i < oldSize; i++) {
+            if (oldKey[i] != 0) {
+                long j = block_hash(oldKey[i] - 1) & pageMask;
+                while (pageKey[j] != 0) {
+                    j = (j + 1) & pageMask;
+                }
+                pageKey[j] = oldKey[i];
+                pageVal[j] = oldVal[i];
+            }
+        }
+        free(oldKey);
+        free(oldVal);
+    }
+
+    long key = vpn + 1;
+    long i = block_hash(vpn) & pageMask;
+    while (pageKey[i] != 0) {
+        if (pageKey[i] == key) {
+            return pageVal[i];
+        }
+        i = (i + 1) & pageMask;
+    }
+    pageKey[i] = key;
+    pageVal[i] = nextFrame++;
+    pageCount++;
+    return pageVal[i];
+}
+
+/** Set up the TLB cache instance and the page table.
+ *
+ * @param TLB set bits, TLB ways and the page bits.
+ * @return None.
+ */
+static void tlb_init(int s, int E, int pageBits) {
+    tlbPageBits = pageBits;
+    init_cache(&tlbCache, s, pageBits, E);
+
+    pageMask = 1024 - 1;
+    pageKey = (long *)calloc((unsigned long)(pageMask + 1), sizeof(long));
+    pageVal = (long *)calloc((unsigned long)(pageMask + 1), sizeof(long));
+    if (!pageKey || !pageVal) {
+        printf("Failed to allocate memory.\n");
+        exit(1);
+    }
+}
+
+static void free_tlb(void) {
+    free(pageKey);
+    free(pageVal);
+}
+
+/** Translate one virtual address, recording the TLB lookup.
+ *
+ * @param the virtual byte address.
+ * @return the physical byte address.
+ */
+static unsigned long tlb_translate(unsigned long addr) {
+    // the TLB is virtually indexed; a miss is the page walk
+    cache_access(&tlbCache, &tlbCache.stats, 'L', addr);
+
+    long vpn = (long)(addr >> (unsigned int)tlbPageBits);
+    unsigned long pfn = (unsigned long)page_lookup(vpn);
+    return (pfn << (unsigned int)tlbPageBits) |
+           (addr & ((1UL << (unsigned int)tlbPageBits) - 1));
+}
+
+/*
+ * Set-partitioned multi-threaded simulation (-j).
+ *
+ * Sets are independent in a set-associative cache, so the trace can be
+ * sharded by set index: worker i owns every set with setIndex % nWorkers
+ * == i and keeps private counters plus a private recency clock. Routing
+ * preserves per-set access order, so the merged results are bit-identical
+ * to the serial path.
+ */
+
+typedef struct {
+    long tag;
+    int setIndex;
+    char op; // 'L' or 'S'
+} AccessRec;
+
+/** @brief Capacity of one worker's record queue */
+#define QUEUE_CAP 65536
+
+/** @brief Records buffered per worker on the reader side before a push */
+#define ROUTE_BATCH 1024
+
+typedef struct {
+    AccessRec buf[QUEUE_CAP];
+    int head, tail, count, closed;
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty, notFull;
+} AccessQueue;
+
+typedef struct worker {
+    AccessQueue queue;
+    SimStats stats;
+    AccessRec batch[ROUTE_BATCH]; // reader-side routing buffer
+    int batchLen;
+    pthread_t tid;
+} Worker;
+
+int nWorkers = 0; // 0 means serial simulation
+Worker *workers = NULL;
+
+/** Append a block of records to a worker queue, blocking while full.
+ *
+ * @param the queue, the records to push, how many there are.
+ * @return None.
+ */
+static void queue_push_batch(AccessQueue *q, const AccessRec *recs, int n) {
+    pthread_mutex_lock(&q->lock);
+    for (int i = 0; i < n; i++) {
+        while (q->count == QUEUE_CAP) {
+            pthread_cond_wait(&q->notFull, &q->lock);
+        }
+        q->buf[q->tail] = recs[i];
+        q->tail = (q->tail + 1) % QUEUE_CAP;
+        q->count++;
+    }
+    pthread_cond_signal(&q->notEmpty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/** Take up to max records off a worker queue, blocking while empty.
+ *
+ * @param the queue, output array, its capacity.
+ * @return the number of records taken, or 0 once the queue is closed and
+ * drained.
+ */
+static int queue_pop_batch(AccessQueue *q, AccessRec *out, int max) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closed) {
+        pthread_cond_wait(&q->notEmpty, &q->lock);
+    }
+    int n = q->count < max ? q->count : max;
+    for (int i = 0; i < n; i++) {
+        out[i] = q->buf[q->head];
+        q->head = (q->head + 1) % QUEUE_CAP;
+    }
+    q->count -= n;
+    pthread_cond_broadcast(&q->notFull);
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+/** Worker thread: drain the queue and simulate the owned sets.
+ *
+ * @param the Worker being run.
+ * @return NULL.
+ */
+static void *worker_main(void *arg) {
+    Worker *w = (Worker *)arg;
+    AccessRec recs[ROUTE_BATCH];
+    int n;
+
+    while ((n = queue_pop_batch(&w->queue, recs, ROUTE_BATCH)) > 0) {
+        for (int i = 0; i < n; i++) {
+            access_cache(&mainCache, &w->stats, recs[i].tag,
+                         recs[i].setIndex, recs[i].op == 'S');
+        }
+    }
+    return NULL;
+}
+
+/** Spawn the worker threads for set-partitioned simulation.
+ *
+ * @param requested number of threads.
+ * @return None.
+ */
+static void start_workers(int n) {
+    workers = (Worker *)calloc((unsigned long)n, sizeof(Worker));
+    if (!workers) {
+        printf("Failed to allocate memory.\n");
+        exit(1);
+    }
+    nWorkers = n;
+    for (int i = 0; i < n; i++) {
+        // continue the (possibly restored) recency clock so restored
+        // timestamps stay older than new accesses
+        workers[i].stats.time = mainCache.stats.time;
+        pthread_mutex_init(&workers[i].queue.lock, NULL);
+        pthread_cond_init(&workers[i].queue.notEmpty, NULL);
+        pthread_cond_init(&workers[i].queue.notFull, NULL);
+        if (pthread_create(&workers[i].tid, NULL, worker_main, &workers[i])) {
+            printf("Failed to create worker thread.\n");
+            exit(1);
+        }
+    }
+}
+
+/** Route one decoded record to the worker owning its set.
+ *
+ * @param operation, tag bits and set index of the record.
+ * @return None.
+ */
+static void route_access(char op, long tag, int setIndex) {
+    Worker *w = &workers[setIndex % nWorkers];
+    w->batch[w->batchLen].tag = tag;
+    w->batch[w->batchLen].setIndex = setIndex;
+    w->batch[w->batchLen].op = op;
+    if (++w->batchLen == ROUTE_BATCH) {
+        queue_push_batch(&w->queue, w->batch, w->batchLen);
+        w->batchLen = 0;
+    }
+}
+
+/** Flush, close and join all workers, merging their counters.
+ *
+ * @param None.
+ * @return None.
+ */
+static void finish_workers(void) {
+    for (int i = 0; i < nWorkers; i++) {
+        Worker *w = &workers[i];
+        if (w->batchLen > 0) {
+            queue_push_batch(&w->queue, w->batch, w->batchLen);
+        }
+        pthread_mutex_lock(&w->queue.lock);
+        w->queue.closed = 1;
+        pthread_cond_broadcast(&w->queue.notEmpty);
+        pthread_mutex_unlock(&w->queue.lock);
+    }
+    for (int i = 0; i < nWorkers; i++) {
+        pthread_join(workers[i].tid, NULL);
+        mainCache.stats.hit += workers[i].stats.hit;
+        mainCache.stats.miss += workers[i].stats.miss;
+        mainCache.stats.eviction += workers[i].stats.eviction;
+        mainCache.stats.dirtyInCache += workers[i].stats.dirtyInCache;
+        mainCache.stats.dirtyEvicted += workers[i].stats.dirtyEvicted;
+        mainCache.stats.writeThrough += workers[i].stats.writeThrough;
+        // carry the furthest recency clock so a later -C snapshot stamps
+        // future fills above every resident timestamp; order within a
+        // set is per-worker, so taking the max stays consistent
+        if (workers[i].stats.time > mainCache.stats.time) {
+            mainCache.stats.time = workers[i].stats.time;
+        }
+    }
+    free(workers);
+    workers = NULL;
+    nWorkers = 0;
+}
+
+/*
+ * Batched record decode for the serial path.
+ *
+ * Records are pre-split into parallel tag/setIndex/isStore arrays using
+ * shift/mask constants computed once at startup, then the whole batch is
+ * simulated back to back; the frontend stops alternating between parse
+ * branches and cache probes on every record.
+ */
+
+/** @brief Records per decode batch */
+#define DECODE_BATCH 4096
+
+// 64-bit lanes and 32-byte alignment so the SIMD pre-decode kernel can
+// load and store whole batches with aligned packed operations
+static unsigned long batchAddr[DECODE_BATCH] __attribute__((aligned(32)));
+static long batchTag[DECODE_BATCH] __attribute__((aligned(32)));
+static long batchSet[DECODE_BATCH] __attribute__((aligned(32)));
+static unsigned char batchStore[DECODE_BATCH];
+static int decodeLen = 0;
+
+// decode constants of the main cache, computed once in decode_init()
+static unsigned int decShift, decB;
+static unsigned long decMask;
+
+#if defined(__x86_64__)
+/** AVX2 pre-decode splitting four packed addresses per instruction.
+ *
+ * @param how many buffered addresses to split.
+ * @return None.
+ */
+__attribute__((target("avx2"))) static void decode_bulk_avx2(int n) {
+    __m256i vmask = _mm256_set1_epi64x((long long)decMask);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i va = _mm256_load_si256((const __m256i *)(batchAddr + i));
+        _mm256_store_si256((__m256i *)(batchTag + i),
+                           _mm256_srli_epi64(va, (int)decShift));
+        _mm256_store_si256(
+            (__m256i *)(batchSet + i),
+            _mm256_srli_epi64(_mm256_and_si256(va, vmask), (int)decB));
+    }
+    for (; i < n; i++) {
+        batchTag[i] = (long)(batchAddr[i] >> decShift);
+        batchSet[i] = (long)((batchAddr[i] & decMask) >> decB);
+    }
+}
+#endif
+
+/** Split the buffered raw addresses into the tag and set index arrays.
+ *
+ * The shift and mask constants are precomputed in decode_init(), so the
+ * scalar fallback is one shift and one shift-and-mask per address.
+ *
+ * @param how many buffered addresses to split.
+ * @return None.
+ */
+static void decode_bulk(int n) {
+#if defined(__x86_64__)
+    if (haveAvx2) {
+        decode_bulk_avx2(n);
+        return;
+    }
+#endif
+    for (int i = 0; i < n; i++) {
+        batchTag[i] = (long)(batchAddr[i] >> decShift);
+        batchSet[i] = (long)((batchAddr[i] & decMask) >> decB);
+    }
+}
+
+/*
+ * Specialized batch kernels for common associativities.
+ *
+ * With a runtime E the compiler can neither unroll the way loops nor
+ * keep a set's tags in registers. The macro below stamps a copy of the
+ * serial LRU access path with E as a compile-time constant for the
+ * shapes we run constantly (direct-mapped and the E=2/4/8 shapes up to
+ * the Haswell L1), so the tag match, empty-line search and timestamp
+ * victim scan all fully unroll with constant masks. A kernel replays
+ * one whole decode batch; decode_init() picks one at startup when the
+ * run is a plain serial LRU simulation and leaves the generic
+ * access_cache() path for everything else (other policies, hierarchies,
+ * and the classify/prefetch/verbose instrumentation).
+ */
+
+#define DEFINE_BATCH_KERNEL(EE)                                                \
+    static void batch_kernel_##EE(int n) {                                     \
+        SimStats *st = &mainCache.stats;                                       \
+        for (int r = 0; r < n; r++) {                                          \
+            long tag = batchTag[r];                                            \
+            int setIndex = (int)batchSet[r];                                   \
+            int isStore = batchStore[r];                                       \
+            long *tags = mainCache.tagArr + (long)setIndex * (EE);             \
+            int *times = mainCache.timeStamp + (long)setIndex * (EE);          \
+            unsigned long *valid = mainCache.validMask + setIndex;             \
+            unsigned long *dirty = mainCache.dirtyMask + setIndex;             \
+            st->time++;                                                        \
+                                                                               \
+            int lineIndex = -1;                                                \
+            for (int j = 0; j < (EE); j++) {                                   \
+                if ((valid[0] >> j & 1UL) && tags[j] == tag) {                 \
+                    lineIndex = j;                                             \
+                    break;                                                     \
+                }                                                              \
+            }                                                                  \
+            if (lineIndex != -1) {                                             \
+                unsigned long bit = 1UL << lineIndex;                          \
+                st->hit++;                                                     \
+                times[lineIndex] = (int)st->time;                              \
+                st->dirtyInCache += isStore & ((dirty[0] & bit) == 0);         \
+                dirty[0] |= bit * (unsigned long)isStore;                      \
+                continue;                                                      \
+            }                                                                  \
+                                                                               \
+            st->miss++;                                                        \
+            unsigned long empty = ~valid[0] & ((1UL << (EE)) - 1);             \
+            int newLineIndex;                                                  \
+            if (empty != 0) {                                                  \
+                newLineIndex = __builtin_ctzl(empty);                          \
+            } else {                                                           \
+                /* seed from line 0; a fixed sentinel underflows on     */     \
+                /* long traces once every timestamp passes it           */     \
+                int minTime = times[0];                                        \
+                newLineIndex = 0;                                              \
+                for (int j = 1; j < (EE); j++) {                               \
+                    if (times[j] < minTime) {                                  \
+                        minTime = times[j];                                    \
+                        newLineIndex = j;                                      \
+                    }                                                          \
+                }                                                              \
+                if (dirty[0] >> newLineIndex & 1UL) {                          \
+                    st->dirtyEvicted++;                                        \
+                    st->dirtyInCache--;                                        \
+                }                                                              \
+                st->eviction++;                                                \
+            }                                                                  \
+            tags[newLineIndex] = tag;                                          \
+            times[newLineIndex] = (int)st->time;                               \
+            valid[0] |= 1UL << newLineIndex;                                   \
+            dirty[0] &= ~(1UL << newLineIndex);                                \
+            dirty[0] |= (1UL << newLineIndex) * (unsigned long)isStore;        \
+            mainCache.pfMask[setIndex] &= ~(1UL << newLineIndex);              \
+            st->dirtyInCache += isStore;                                       \
+        }                                                                      \
+    }
+
+DEFINE_BATCH_KERNEL(1)
+DEFINE_BATCH_KERNEL(2)
+DEFINE_BATCH_KERNEL(4)
+DEFINE_BATCH_KERNEL(8)
+
+// batch kernel picked at startup, NULL for the generic path
+static void (*batchKernel)(int) = NULL;
+
+int collapseMode = 0;          // --collapse given
+static int collapseActive = 0; // decode_init() checked the run qualifies
+
+/** Simulate one decode batch with consecutive repeats collapsed.
+ *
+ * Tight loops emit long runs of accesses to the same (op, set, tag)
+ * triple. Under write-back write-allocate LRU every repeat after the
+ * first is a hit on the newest line of its set, so a run of k repeats
+ * is applied in O(1): count k hits, advance the clock by k and stamp
+ * the line's timestamp once with the final time. The final counters
+ * and cache state are bit-identical to replaying every record.
+ *
+ * @param how many buffered records to simulate.
+ * @return None.
+ */
+static void flush_collapsed(int n) {
+    SimStats *st = &mainCache.stats;
+    int i = 0;
+    while (i < n) {
+        int j = i + 1;
+        while (j < n && batchTag[j] == batchTag[i] &&
+               batchSet[j] == batchSet[i] &&
+               batchStore[j] == batchStore[i]) {
+            j++;
+        }
+        access_cache(&mainCache, st, batchTag[i], (int)batchSet[i],
+                     batchStore[i]);
+        long k = j - i - 1;
+        if (k > 0) {
+            st->hit += k;
+            st->time += k;
+            int lineIndex =
+                find_matched_line(&mainCache, batchTag[i], (int)batchSet[i]);
+            mainCache.timeStamp[(long)batchSet[i] * mainCache.E + lineIndex] =
+                (int)st->time;
+        }
+        i = j;
+    }
+}
+
+/** Precompute the address-decode constants of the main cache and pick
+ * a specialized batch kernel when the shape and mode allow one.
+ *
+ * @param None.
+ * @return None.
+ */
+static void decode_init(void) {
+    decShift = (unsigned int)(mainCache.s + mainCache.b);
+    decB = (unsigned int)mainCache.b;
+    decMask = (1UL << decShift) - 1;
+
+    // the specialized kernels and the run-length collapse cover the
+    // plain serial write-back LRU path only
+    batchKernel = NULL;
+    collapseActive = 0;
+    if (scalarMode || mainCache.policy != REPL_LRU ||
+        mainCache.wpolicy != WP_WB_WA || mainCache.next != NULL ||
+        classifyMode || prefetchMode || verboseMode || heatmapMode) {
+        return;
+    }
+    collapseActive = collapseMode;
+    switch (mainCache.E) {
+    case 1:
+        batchKernel = batch_kernel_1;
+        break;
+
+    case 2:
+        batchKernel = batch_kernel_2;
+        break;
+
+    case 4:
+        batchKernel = batch_kernel_4;
+        break;
+
+    case 8:
+        batchKernel = batch_kernel_8;
+        break;
+
+    default:
+        break;
+    }
+}
+
+/** Simulate every record buffered in the decode batch.
+ *
+ * @param None.
+ * @return None.
+ */
+static void flush_decode_batch(void) {
+    decode_bulk(decodeLen);
+
+    // set-partitioned mode consumes the pre-decoded set indices to route
+    // records to their shards without touching the addresses again
+    if (nWorkers > 0) {
+        for (int i = 0; i < decodeLen; i++) {
+            route_access(batchStore[i] ? 'S' : 'L', batchTag[i],
+                         (int)batchSet[i]);
+        }
+        decodeLen = 0;
+        return;
+    }
+    if (collapseActive) {
+        flush_collapsed(decodeLen);
+        decodeLen = 0;
+        return;
+    }
+    if (batchKernel) {
+        batchKernel(decodeLen);
+        decodeLen = 0;
+        return;
+    }
+    for (int i = 0; i < decodeLen; i++) {
+        access_cache(&mainCache, &mainCache.stats, batchTag[i],
+                     (int)batchSet[i], batchStore[i]);
+    }
+    decodeLen = 0;
+}
+
+/*
+ * Periodic interval reporting (--interval).
+ *
+ * Every N accesses the deltas of the main counters over the previous
+ * interval are snapshotted into a ring buffer drained by a dedicated
+ * writer thread, so a long run can be watched (and killed early) while
+ * it is still going. The hot path pays one down-count and compare per
+ * access; the snapshot and all I/O happen once per interval, off the
+ * simulating thread. Rows stream as CSV text to stdout, or as fixed
+ * binary IntervalRow records to the --interval-log file.
+ */
+
+int intervalMode = 0;        // --interval given
+static long intervalLen = 0; // accesses per reported interval
+static long intervalLeft;    // accesses until the next snapshot
+static long intervalSeen;    // accesses covered by snapshots so far
+static SimStats intervalBase; // counters at the last snapshot
+
+typedef struct {
+    long accesses; // accesses replayed up to this row
+    long hit, miss, eviction, dirtyEvicted; // deltas over the interval
+} IntervalRow;
+
+/** @brief Capacity of the snapshot ring buffer */
+#define INTERVAL_RING 1024
+
+static IntervalRow intervalRing[INTERVAL_RING];
+static int intervalHead, intervalTail, intervalCount, intervalClosed;
+static pthread_mutex_t intervalLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t intervalNotEmpty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t intervalNotFull = PTHREAD_COND_INITIALIZER;
+static pthread_t intervalTid;
+static int intervalFd = -1; // binary destination, -1 for CSV on stdout
+
+/** Writer thread: drain snapshot rows from the ring and emit them.
+ *
+ * @param unused.
+ * @return NULL.
+ */
+static void *interval_writer(void *arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&intervalLock);
+        while (intervalCount == 0 && !intervalClosed) {
+            pthread_cond_wait(&intervalNotEmpty, &intervalLock);
+        }
+        if (intervalCount == 0) {
+            pthread_mutex_unlock(&intervalLock);
+            return NULL;
+        }
+        IntervalRow row = intervalRing[intervalHead];
+        intervalHead = (intervalHead + 1) % INTERVAL_RING;
+        intervalCount--;
+        pthread_cond_signal(&intervalNotFull);
+        pthread_mutex_unlock(&intervalLock);
+
+        if (intervalFd >= 0) {
+            if (write(intervalFd, &row, sizeof(row)) != sizeof(row)) {
+                printf("Failed to write the interval log.\n");
+                exit(1);
+            }
+        } else {
+            printf("%ld,%ld,%ld,%ld,%ld\n", row.accesses, row.hit, row.miss,
+                   row.eviction, row.dirtyEvicted);
+            fflush(stdout);
+        }
+    }
+}
+
+/** Snapshot the counter deltas of one finished interval into the ring.
+ *
+ * @param how many accesses the interval covered.
+ * @return None.
+ */
+static void interval_push(long accesses) {
+    flush_decode_batch(); // the deltas must include the buffered records
+    intervalSeen += accesses;
+
+    IntervalRow row;
+    row.accesses = intervalSeen;
+    row.hit = mainCache.stats.hit - intervalBase.hit;
+    row.miss = mainCache.stats.miss - intervalBase.miss;
+    row.eviction = mainCache.stats.eviction - intervalBase.eviction;
+    row.dirtyEvicted =
+        mainCache.stats.dirtyEvicted - intervalBase.dirtyEvicted;
+    intervalBase = mainCache.stats;
+    intervalLeft = intervalLen;
+
+    pthread_mutex_lock(&intervalLock);
+    while (intervalCount == INTERVAL_RING) {
+        pthread_cond_wait(&intervalNotFull, &intervalLock);
+    }
+    intervalRing[intervalTail] = row;
+    intervalTail = (intervalTail + 1) % INTERVAL_RING;
+    intervalCount++;
+    pthread_cond_signal(&intervalNotEmpty);
+    pthread_mutex_unlock(&intervalLock);
+}
+
+/** Start the interval writer thread and take the base snapshot.
+ *
+ * @param the --interval-log file, or NULL for CSV on stdout.
+ * @return None.
+ */
+static void interval_init(const char *logFile) {
+    if (logFile) {
+        intervalFd = open(logFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (intervalFd < 0) {
+            printf("Failed to open the interval log.\n");
+            exit(1);
+        }
+    } else {
+        printf("accesses,hits,misses,evictions,dirty_evictions\n");
+    }
+    intervalBase = mainCache.stats;
+    intervalLeft = intervalLen;
+    if (pthread_create(&intervalTid, NULL, interval_writer, NULL)) {
+        printf("Failed to create interval writer thread.\n");
+        exit(1);
+    }
+}
+
+/** Flush the trailing partial interval and retire the writer thread.
+ *
+ * @param None.
+ * @return None.
+ */
+static void interval_finish(void) {
+    if (intervalLeft < intervalLen) {
+        interval_push(intervalLen - intervalLeft);
+    }
+    pthread_mutex_lock(&intervalLock);
+    intervalClosed = 1;
+    pthread_cond_broadcast(&intervalNotEmpty);
+    pthread_mutex_unlock(&intervalLock);
+    pthread_join(intervalTid, NULL);
+    if (intervalFd >= 0) {
+        close(intervalFd);
+    }
+}
+
+/** Replay one trace record against the configured cache(s).
+ *
+ * @param action, address and access size of the record.
+ * @return None.
+ */
+static void replay_access(char action, unsigned long addr, int size) {
+    if (size < 0 || size >= MAX_SIZE) {
+        printf("Size is out of range\n");
+        exit(1);
+    }
+    if (action != 'L' && action != 'S') {
+        printf("Invalid action\n");
+        exit(1);
+    }
+
+    // translate before any tag/set extraction so indexing is physical
+    if (tlbMode) {
+        addr = tlb_translate(addr);
+    }
+
+    // sweep mode: the record is decoded once per instance, so one pass
+    // over the trace feeds every configuration
+    if (nSweep > 0) {
+        for (int i = 0; i < nSweep; i++) {
+            cache_access(&sweepCaches[i], &sweepCaches[i].stats, action, addr);
+        }
+        return;
+    }
+
+    // sampling simulates a subset of the records directly
+    if (sampleMode) {
+        sample_access(action, addr);
+        return;
+    }
+
+    // verbose runs bypass the decode batch so the outcome can be paired
+    // with the original address and size of the record
+    if (verboseMode) {
+        cache_access(&mainCache, &mainCache.stats, action, addr);
+        verbose_record(action, addr, size, verbFlags);
+        if (intervalMode && --intervalLeft == 0) {
+            interval_push(intervalLen);
+        }
+        return;
+    }
+
+    // buffer the raw address; the batch is split in bulk at flush time
+    // and then simulated, or routed to the worker shards
+    batchAddr[decodeLen] = addr;
+    batchStore[decodeLen] = action == 'S';
+    decodeLen++;
+
+    // the down-count runs after the record is committed to the batch, so
+    // the flush inside interval_push() includes the interval's own last
+    // access in its row
+    if (intervalMode && --intervalLeft == 0) {
+        interval_push(intervalLen);
+    }
+    if (decodeLen == DECODE_BATCH) {
+        flush_decode_batch();
+    }
+}
+
+/*
+ * Double-buffered asynchronous trace ingestion (-a).
+ *
+ * A reader thread parses the trace into one of two large record buffers
+ * while the main thread simulates the other, so trace I/O and simulation
+ * overlap instead of strictly alternating. The handoff is one lock-free
+ * full-flag flip per buffer (release on publish, acquire on take).
+ */
+
+int process_trace_packed(const char *trace);
+int process_trace_file(const char *trace);
+
+/** @brief Records per pipeline buffer */
+#define PIPE_BUF_RECS 65536
+
+typedef struct {
+    unsigned long addr;
+    int size;
+    char op;
+} ParsedRec;
+
+typedef struct {
+    ParsedRec recs[PIPE_BUF_RECS];
+    int count;
+    atomic_int full; // 0: owned by the reader, 1: owned by the simulator
+} PipeBuf;
+
+int asyncPipe = 0; // set by -a; parsing then runs on the reader thread
+static PipeBuf pipeBufs[2];
+static int fillIdx = 0;          // buffer the reader is filling
+static atomic_int readerDone;
+
+/** Publish the reader's current buffer and take over the other one.
+ *
+ * @param None.
+ * @return None.
+ */
+static void pipe_publish(void) {
+    atomic_store_explicit(&pipeBufs[fillIdx].full, 1, memory_order_release);
+    fillIdx ^= 1;
+
+    // wait until the simulator has drained the other buffer
+    while (
+        atomic_load_explicit(&pipeBufs[fillIdx].full, memory_order_acquire)) {
+        sched_yield();
+    }
+}
+
+/*
+ * Benchmark instrumentation (-B).
+ *
+ * Records are collected into a small batch so the monotonic clock only
+ * flips between the parse and simulate phases once per batch; the report
+ * phase is timed around printSummary(). The split is printed as one
+ * machine-readable line consumed by csim-bench.
+ */
+
+int benchMode = 0;
+
+/** @brief Records per benchmark timing batch */
+#define BENCH_BATCH 4096
+
+static ParsedRec benchBuf[BENCH_BATCH];
+static int benchLen = 0;
+static double parseSec = 0, simSec = 0, reportSec = 0;
+static struct timespec benchMark; // start of the phase currently billed
+
+/** Restart the phase clock.
+ *
+ * @param None.
+ * @return seconds elapsed since the previous mark.
+ */
+static double bench_lap(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double d = (double)(now.tv_sec - benchMark.tv_sec) +
+               (double)(now.tv_nsec - benchMark.tv_nsec) * 1e-9;
+    benchMark = now;
+    return d;
+}
+
+/** Simulate the buffered benchmark batch, billing the clock per phase.
+ *
+ * @param None.
+ * @return None.
+ */
+static void bench_flush(void) {
+    parseSec += bench_lap();
+    for (int i = 0; i < benchLen; i++) {
+        replay_access(benchBuf[i].op, benchBuf[i].addr, benchBuf[i].size);
+    }
+    simSec += bench_lap();
+    benchLen = 0;
+}
+
+/** Accept one parsed record from a trace parser.
+ *
+ * Simulates the record directly, or buffers it for the simulation thread
+ * when the asynchronous pipeline is on.
+ *
+ * @param action, address and access size of the record.
+ * @return None.
+ */
+static void emit_access(char action, unsigned long addr, int size) {
+    if (benchMode) {
+        benchBuf[benchLen].addr = addr;
+        benchBuf[benchLen].size = size;
+        benchBuf[benchLen].op = action;
+        if (++benchLen == BENCH_BATCH) {
+            bench_flush();
+        }
+        return;
+    }
+    if (!asyncPipe) {
+        replay_access(action, addr, size);
+        return;
+    }
+    PipeBuf *pb = &pipeBufs[fillIdx];
+    pb->recs[pb->count].addr = addr;
+    pb->recs[pb->count].size = size;
+    pb->recs[pb->count].op = action;
+    if (++pb->count == PIPE_BUF_RECS) {
+        pipe_publish();
+    }
+}
+
+typedef struct {
+    const char *path;
+    int packed;
+} ReaderArgs;
+
+/** Reader thread: parse the whole trace into the pipeline.
+ *
+ * @param the ReaderArgs describing the trace.
+ * @return NULL.
+ */
+static void *reader_main(void *arg) {
+    ReaderArgs *ra = (ReaderArgs *)arg;
+    if (ra->packed) {
+        process_trace_packed(ra->path);
+    } else {
+        process_trace_file(ra->path);
+    }
+    if (pipeBufs[fillIdx].count > 0) {
+        pipe_publish();
+    }
+    atomic_store_explicit(&readerDone, 1, memory_order_release);
+    return NULL;
+}
+
+/** Simulation side of the pipeline: drain buffers as they are published.
+ *
+ * @param None.
+ * @return None.
+ */
+static void drain_pipe(void) {
+    int idx = 0;
+    for (;;) {
+        PipeBuf *pb = &pipeBufs[idx];
+        while (!atomic_load_explicit(&pb->full, memory_order_acquire)) {
+            if (atomic_load_explicit(&readerDone, memory_order_acquire) &&
+                !atomic_load_explicit(&pb->full, memory_order_acquire)) {
+                return;
+            }
+            sched_yield();
+        }
+        for (int i = 0; i < pb->count; i++) {
+            replay_access(pb->recs[i].op, pb->recs[i].addr, pb->recs[i].size);
+        }
+        pb->count = 0;
+        atomic_store_explicit(&pb->full, 0, memory_order_release);
+        idx ^= 1;
+    }
+}
+
+/** Scan one "<op> <hex>,<dec>" record out of a mapped ASCII trace.
+ *
+ * Hand-rolled hex/decimal parsing; *pp is advanced past the record.
+ *
+ * @param cursor into the mapped bytes, end of the mapping, and the
+ * record's action, address and size outputs.
+ * @return 1 if a record was scanned, 0 at end of input.
+ */
+static int scan_ascii_record(const char **pp, const char *end, char *action,
+                             unsigned long *addr, int *size) {
+    const char *p = *pp;
+
+    // skip blank space between records
+    while (p < end &&
+           (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+        p++;
+    }
+    if (p >= end) {
+        *pp = p;
+        return 0;
+    }
+
+    *action = *p++;
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+
+    // hex address up to the ',' separator
+    *addr = 0;
+    while (p < end) {
+        char c = *p;
+        if (c >= '0' && c <= '9') {
+            *addr = (*addr << 4) | (unsigned long)(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            *addr = (*addr << 4) | (unsigned long)(c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            *addr = (*addr << 4) | (unsigned long)(c - 'A' + 10);
+        } else {
+            break;
+        }
+        p++;
+    }
+    if (p >= end || *p != ',') {
+        printf("Invalid action\n");
+        exit(1);
+    }
+    p++;
+
+    // decimal access size
+    *size = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        *size = *size * 10 + (*p - '0');
+        p++;
+    }
+
+    *pp = p;
+    return 1;
+}
+
+/** Parse a memory-mapped ASCII trace by walking the bytes directly.
+ *
+ * @param mapped trace bytes, number of bytes.
+ * @return None.
+ */
+static void process_trace_mapped(const char *buf, size_t len) {
+    const char *p = buf, *end = buf + len;
+    char action;
+    unsigned long addr;
+    int size;
+
+    while (scan_ascii_record(&p, end, &action, &addr, &size)) {
+        emit_access(action, addr, size);
+    }
+}
+
+/*
+ * Shared-memory trace cache (-m).
+ *
+ * The first invocation parses an ASCII trace into a POSIX shared-memory
+ * segment of packed records, named by a hash of the trace path and its
+ * mtime; subsequent invocations attach the segment read-only and skip
+ * file I/O and parsing entirely. Grading-style wrappers that run many
+ * configurations over the same trace pay the parse once.
+ */
+
+/** @brief Marks a fully-built shared trace segment */
+typedef struct {
+    unsigned long magic;
+    unsigned long nrecs;
+    int ready; // set last, after all records are in place
+} ShmTraceHeader;
+
+/** FNV-1a hash of a byte string folded with a seed.
+ *
+ * @param the bytes, a seed mixed in first.
+ * @return the 64-bit hash.
+ */
+static unsigned long hash64(const char *s, unsigned long seed) {
+    unsigned long h = 0xcbf29ce484222325UL ^ seed;
+    while (*s) {
+        h ^= (unsigned long)(unsigned char)*s++;
+        h *= 0x100000001b3UL;
+    }
+    return h;
+}
+
+/** Replay every record of a shared trace segment.
+ *
+ * @param the segment header (records follow it).
+ * @return None.
+ */
+static void replay_shm_records(const ShmTraceHeader *hdr) {
+    const trace_rec_t *recs = (const trace_rec_t *)(hdr + 1);
+    for (unsigned long i = 0; i < hdr->nrecs; i++) {
+        char action = trace_rec_op(recs[i]) == TRACE_OP_STORE ? 'S' : 'L';
+        emit_access(action, trace_rec_addr(recs[i]),
+                    (int)trace_rec_size(recs[i]));
+    }
+}
+
+int process_trace_file(const char *trace);
+
+/** Process an ASCII trace through the shared-memory trace cache.
+ *
+ * Attaches the segment for this trace if a previous run built it,
+ * otherwise parses the file once into a new segment; any failure falls
+ * back to plain file processing.
+ *
+ * @param trace Name of the trace file to process.
+ * @return None.
+ */
+static void process_trace_shared(const char *trace) {
+    struct stat st;
+    if (stat(trace, &st) != 0 || !S_ISREG(st.st_mode)) {
+        process_trace_file(trace);
+        return;
+    }
+
+    char name[64];
+    sprintf(name, "/csim-%016lx",
+            hash64(trace, (unsigned long)st.st_mtime));
+
+    // fast path: a previous run already parsed this trace
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd >= 0) {
+        struct stat shmSt;
+        if (fstat(fd, &shmSt) == 0 && shmSt.st_size > 0) {
+            const ShmTraceHeader *hdr = mmap(NULL, (size_t)shmSt.st_size,
+                                             PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+            if (hdr != MAP_FAILED) {
+                if (hdr->magic == TRACEPACK_MAGIC && hdr->ready) {
+                    replay_shm_records(hdr);
+                    munmap((void *)hdr, (size_t)shmSt.st_size);
+                    return;
+                }
+                munmap((void *)hdr, (size_t)shmSt.st_size);
+            }
+        } else {
+            close(fd);
+        }
+        process_trace_file(trace);
+        return;
+    }
+
+    // build the segment; any failure falls back to plain processing
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        process_trace_file(trace);
+        return;
+    }
+
+    int tfd = open(trace, O_RDONLY);
+    char *tbuf = MAP_FAILED;
+    if (tfd >= 0 && st.st_size > 0) {
+        tbuf = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, tfd, 0);
+    }
+    if (tfd >= 0) {
+        close(tfd);
+    }
+
+    // the shortest record is 6 bytes, which bounds the record count
+    size_t maxRecs = (size_t)st.st_size / 6 + 1;
+    size_t segSize = sizeof(ShmTraceHeader) + maxRecs * sizeof(trace_rec_t);
+    ShmTraceHeader *hdr = MAP_FAILED;
+    if (tbuf != MAP_FAILED && ftruncate(fd, (off_t)segSize) == 0) {
+        hdr = mmap(NULL, segSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (hdr == MAP_FAILED) {
+        shm_unlink(name);
+        if (tbuf != MAP_FAILED) {
+            munmap(tbuf, (size_t)st.st_size);
+        }
+        process_trace_file(trace);
+        return;
+    }
+
+    trace_rec_t *recs = (trace_rec_t *)(hdr + 1);
+    const char *p = tbuf, *end = tbuf + st.st_size;
+    unsigned long n = 0;
+    char action;
+    unsigned long addr;
+    int size;
+    while (scan_ascii_record(&p, end, &action, &addr, &size)) {
+        recs[n++] = trace_rec_pack(action == 'S' ? TRACE_OP_STORE
+                                                 : TRACE_OP_LOAD,
+                                   addr, (unsigned long)size);
+    }
+    munmap(tbuf, (size_t)st.st_size);
+
+    hdr->magic = TRACEPACK_MAGIC;
+    hdr->nrecs = n;
+    hdr->ready = 1; // published last: attachers check it before replaying
+
+    replay_shm_records(hdr);
+    munmap(hdr, segSize);
+}
+
+/** Process a packed binary trace file (see tracepack.h).
+ *
+ * Records are fixed 8-byte words streamed with bulk reads, so no parsing
+ * happens on the hot path at all.
+ *
+ * @param trace Name of the packed trace file to process.
+ * @return 0 if successful , 1 if there were errors.
+ */
+int process_trace_packed(const char *trace) {
+    FILE *tfp = fopen(trace, "rb");
+    if (!tfp) {
+        fprintf(stderr, "Error opening'%s'\n", trace);
+        exit(1);
+    }
+
+    trace_rec_t magic = 0;
+    if (fread(&magic, sizeof(magic), 1, tfp) != 1 ||
+        magic != TRACEPACK_MAGIC) {
+        printf("'%s' is not a packed trace\n", trace);
+        exit(1);
+    }
+
+    static trace_rec_t buf[65536];
+    size_t n;
+    while ((n = fread(buf, sizeof(trace_rec_t), 65536, tfp)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            char action =
+                trace_rec_op(buf[i]) == TRACE_OP_STORE ? 'S' : 'L';
+            emit_access(action, trace_rec_addr(buf[i]),
+                        (int)trace_rec_size(buf[i]));
+        }
+    }
+    fclose(tfp);
+    return 0;
+}
+
+/** Process a memory -access trace file.
+ *
+ * Regular files are mmap()ed and parsed in place; anything else (pipes,
+ * fifos) falls back to the original fscanf() loop.
+ *
+ * @param trace Name of the trace file to process.
+ * @return 0 if successful , 1 if there were errors.
+ */
+int process_trace_file(const char *trace) {
+    int fd = open(trace, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error opening'%s'\n", trace);
+        exit(1);
+    }
+
+    // fast path: map regular files and parse the bytes directly
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        char *buf =
+            mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (buf != MAP_FAILED) {
+            close(fd);
+            process_trace_mapped(buf, (size_t)st.st_size);
+            munmap(buf, (size_t)st.st_size);
+            return 0;
+        }
+    }
+
+    FILE *tfp = fdopen(fd, "rt");
+    if (!tfp) {
+        fprintf(stderr, "Error opening'%s'\n", trace);
+        exit(1);
+    }
+    int size, parse_error = 0;
+    unsigned long addr;
+    char action;
+
+    // scan each line in the trace, and act accordingly
+    while (fscanf(tfp, " %c %lx,%d", &action, &addr, &size) > 0) {
+        emit_access(action, addr, size);
+    }
+    fclose(tfp);
+    return parse_error;
+}
+
+/** Build the extra cache levels of a hierarchy from an -L spec.
+ *
+ * The spec lists one "s,E,b" triple per level, colon separated, ordered
+ * from the level directly behind the first-level cache outward. Levels
+ * are chained through ->next so misses and dirty writebacks propagate.
+ *
+ * @param spec The -L option argument.
+ * @return None.
+ */
+static void load_hierarchy_spec(char *spec) {
+    // count levels first so the chain can live in one array
+    int n = 1;
+    for (char *p = spec; *p; p++) {
+        if (*p == ':') {
+            n++;
+        }
+    }
+    extraLevels = (Cache *)arena_alloc(sizeof(Cache) * (unsigned long)n);
+
+    char *save = NULL;
+    for (char *tok = strtok_r(spec, ":", &save); tok;
+         tok = strtok_r(NULL, ":", &save)) {
+        int cs, cE, cb;
+        if (sscanf(tok, "%d,%d,%d", &cs, &cE, &cb) != 3) {
+            printf("Incorrect Invocations.\n");
+            exit(1);
+        }
+        checkValidInput(cs, cb, cE, spec);
+        init_cache(&extraLevels[nExtraLevels], cs, cb, cE);
+        if (nExtraLevels > 0) {
+            extraLevels[nExtraLevels - 1].next = &extraLevels[nExtraLevels];
+        }
+        nExtraLevels++;
+    }
+}
+
+/*
+ * Checkpoint/restore of simulator state (-C / -R).
+ *
+ * The state file carries a versioned header, the counters, and the
+ * per-line metadata arrays plus replacement-policy state, so a restored
+ * run continues exactly where the saved one stopped; only the new trace
+ * segment has to be replayed.
+ */
+
+/** @brief Magic word leading a state file ("csm-st01") */
+#define STATE_MAGIC 0x63736d2d73743031UL
+
+/** @brief Bumped whenever the state layout changes */
+#define STATE_VERSION 4 // v4: split-array line metadata serialized as-is
+
+typedef struct {
+    unsigned long magic;
+    int version;
+    int s, b, E;
+    int policy;
+} StateHeader;
+
+/** Serialize one cache instance and its counters to a state file.
+ *
+ * @param the instance, name of the state file to write.
+ * @return None.
+ */
+static void save_state(const Cache *c, const char *path) {
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "Error opening'%s'\n", path);
+        exit(1);
+    }
+
+    StateHeader hdr = {STATE_MAGIC, STATE_VERSION, c->s, c->b, c->E,
+                       (int)c->policy};
+    unsigned long nLines = (unsigned long)c->S * (unsigned long)c->E;
+    unsigned long nWords = (unsigned long)c->S * (unsigned long)c->maskWords;
+    int ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 &&
+             fwrite(&c->stats, sizeof(c->stats), 1, fp) == 1 &&
+             fwrite(c->lruHead, sizeof(int), (unsigned long)c->S, fp) ==
+                 (unsigned long)c->S &&
+             fwrite(c->lruTail, sizeof(int), (unsigned long)c->S, fp) ==
+                 (unsigned long)c->S &&
+             fwrite(c->tagArr, sizeof(long), nLines, fp) == nLines &&
+             fwrite(c->timeStamp, sizeof(int), nLines, fp) == nLines &&
+             fwrite(c->lruPrev, sizeof(int), nLines, fp) == nLines &&
+             fwrite(c->lruNext, sizeof(int), nLines, fp) == nLines &&
+             fwrite(c->validMask, sizeof(unsigned long), nWords, fp) ==
+                 nWords &&
+             fwrite(c->dirtyMask, sizeof(unsigned long), nWords, fp) ==
+                 nWords &&
+             fwrite(c->pfMask, sizeof(unsigned long), nWords, fp) == nWords &&
+             fwrite(&c->randState, sizeof(c->randState), 1, fp) == 1;
+    if (ok && c->plruBits) {
+        unsigned long n = (unsigned long)c->S * (unsigned long)c->plruWords;
+        ok = fwrite(c->plruBits, sizeof(unsigned long), n, fp) == n;
+    }
+    if (ok && c->rrpv) {
+        ok = fwrite(c->rrpv, 1, nLines, fp) == nLines;
+    }
+    if (!ok || fclose(fp) != 0) {
+        fprintf(stderr, "Error writing'%s'\n", path);
+        exit(1);
+    }
+}
+
+/** Initialize a cache instance from a saved state file.
+ *
+ * The geometry and policy come from the file; -s/-E/-b given on the
+ * command line must match it when present.
+ *
+ * @param the instance, name of the state file, the command line s/b/E.
+ * @return None.
+ */
+static void restore_state(Cache *c, const char *path, int s, int b, int E) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "Error opening'%s'\n", path);
+        exit(1);
+    }
+
+    StateHeader hdr;
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || hdr.magic != STATE_MAGIC ||
+        hdr.version != STATE_VERSION) {
+        printf("'%s' is not a csim state file\n", path);
+        exit(1);
+    }
+    if ((s >= 0 && s != hdr.s) || (b >= 0 && b != hdr.b) ||
+        (E > 0 && E != hdr.E)) {
+        printf("State file '%s' was saved with s=%d, E=%d, b=%d\n", path,
+               hdr.s, hdr.E, hdr.b);
+        exit(1);
+    }
+
+    defaultPolicy = (ReplPolicy)hdr.policy;
+    init_cache(c, hdr.s, hdr.b, hdr.E);
+
+    unsigned long nLines = (unsigned long)c->S * (unsigned long)c->E;
+    unsigned long nWords = (unsigned long)c->S * (unsigned long)c->maskWords;
+    int ok = fread(&c->stats, sizeof(c->stats), 1, fp) == 1 &&
+             fread(c->lruHead, sizeof(int), (unsigned long)c->S, fp) ==
+                 (unsigned long)c->S &&
+             fread(c->lruTail, sizeof(int), (unsigned long)c->S, fp) ==
+                 (unsigned long)c->S &&
+             fread(c->tagArr, sizeof(long), nLines, fp) == nLines &&
+             fread(c->timeStamp, sizeof(int), nLines, fp) == nLines &&
+             fread(c->lruPrev, sizeof(int), nLines, fp) == nLines &&
+             fread(c->lruNext, sizeof(int), nLines, fp) == nLines &&
+             fread(c->validMask, sizeof(unsigned long), nWords, fp) ==
+                 nWords &&
+             fread(c->dirtyMask, sizeof(unsigned long), nWords, fp) ==
+                 nWords &&
+             fread(c->pfMask, sizeof(unsigned long), nWords, fp) == nWords &&
+             fread(&c->randState, sizeof(c->randState), 1, fp) == 1;
+    if (ok && c->plruBits) {
+        unsigned long n = (unsigned long)c->S * (unsigned long)c->plruWords;
+        ok = fread(c->plruBits, sizeof(unsigned long), n, fp) == n;
+    }
+    if (ok && c->rrpv) {
+        ok = fread(c->rrpv, 1, nLines, fp) == nLines;
+    }
+    fclose(fp);
+    if (!ok) {
+        fprintf(stderr, "Error reading'%s'\n", path);
+        exit(1);
+    }
+}
+
+/** Load a sweep configuration file: one "s E b" triple per line.
+ *
+ * Every listed configuration gets its own cache instance; the trace is
+ * then decoded once and replayed into all of them in a single pass.
+ *
+ * @param path Name of the configuration file.
+ * @return None.
+ */
+static void load_sweep_configs(const char *path) {
+    FILE *fp = fopen(path, "rt");
+    if (!fp) {
+        fprintf(stderr, "Error opening'%s'\n", path);
+        exit(1);
+    }
+
+    int cap = 16;
+    sweepCaches = (Cache *)malloc(sizeof(Cache) * (unsigned long)cap);
+    if (!sweepCaches) {
+        printf("Failed to allocate memory.\n");
+        exit(1);
+    }
+
+    int cs, cE, cb;
+    while (fscanf(fp, " %d %d %d", &cs, &cE, &cb) == 3) {
+        checkValidInput(cs, cb, cE, (char *)path);
+        if (nSweep == cap) {
+            cap *= 2;
+            sweepCaches =
+                (Cache *)realloc(sweepCaches, sizeof(Cache) * (unsigned long)cap);
+            if (!sweepCaches) {
+                printf("Failed to allocate memory.\n");
+                exit(1);
+            }
+        }
+        init_cache(&sweepCaches[nSweep], cs, cb, cE);
+        nSweep++;
+    }
+    fclose(fp);
+
+    if (nSweep == 0) {
+        printf("Incorrect Invocations.\n");
+        exit(1);
+    }
+}
+
+/*
+ * Multi-trace job driver (-M).
+ *
+ * A manifest lists independent (s, E, b, trace) jobs, one per line, and
+ * a thread pool simulates them in one process: no fork/exec per trace,
+ * no repeated binary startup, and every job's state comes from the
+ * shared arena. Jobs are taken from a single atomic index over the job
+ * list sorted by trace size, longest first, so the pool drains evenly
+ * -- with independent coarse-grained jobs this gives the same balance
+ * as per-thread deques with stealing, without the machinery. Results
+ * are reported per job in manifest order plus an aggregate row.
+ */
+
+typedef struct {
+    char trace[1000];
+    int s, E, b;
+    long bytes; // trace file size, for longest-first scheduling
+    Cache cache;
+} TraceJob;
+
+static TraceJob *traceJobs = NULL;
+static int *jobOrder = NULL; // job indices sorted by descending size
+static int nTraceJobs = 0;
+static atomic_int nextTraceJob;
+
+/** Load the job manifest.
+ *
+ * Each line holds "s E b trace"; every job is validated and stat'ed up
+ * front so scheduling can put the longest traces first.
+ *
+ * @param path Name of the manifest file.
+ * @return None.
+ */
+static void load_job_manifest(const char *path) {
+    FILE *fp = fopen(path, "rt");
+    if (!fp) {
+        fprintf(stderr, "Error opening'%s'\n", path);
+        exit(1);
+    }
+
+    int cap = 16;
+    traceJobs = (TraceJob *)malloc(sizeof(TraceJob) * (unsigned long)cap);
+    if (!traceJobs) {
+        printf("Failed to allocate memory.\n");
+        exit(1);
+    }
+
+    int cs, cE, cb;
+    char tpath[1000];
+    while (fscanf(fp, " %d %d %d %999s", &cs, &cE, &cb, tpath) == 4) {
+        checkValidInput(cs, cb, cE, tpath);
+        if (nTraceJobs == cap) {
+            cap *= 2;
+            traceJobs = (TraceJob *)realloc(traceJobs, sizeof(TraceJob) *
+                                                           (unsigned long)cap);
+            if (!traceJobs) {
+                printf("Failed to allocate memory.\n");
+                exit(1);
+            }
+        }
+        TraceJob *j = &traceJobs[nTraceJobs];
+        strcpy(j->trace, tpath);
+        j->s = cs;
+        j->E = cE;
+        j->b = cb;
+        struct stat st;
+        if (stat(tpath, &st) != 0) {
+            fprintf(stderr, "Error opening'%s'\n", tpath);
+            exit(1);
+        }
+        j->bytes = (long)st.st_size;
+        nTraceJobs++;
+    }
+    fclose(fp);
+
+    if (nTraceJobs == 0) {
+        printf("Incorrect Invocations.\n");
+        exit(1);
+    }
+
+    // longest trace first, so no thread is left alone with it at the end
+    jobOrder = (int *)malloc(sizeof(int) * (unsigned long)nTraceJobs);
+    if (!jobOrder) {
+        printf("Failed to allocate memory.\n");
+        exit(1);
+    }
+    for (int i = 0; i < nTraceJobs; i++) {
+        jobOrder[i] = i;
+    }
+    for (int i = 1; i < nTraceJobs; i++) {
+        int v = jobOrder[i], k = i;
+        while (k > 0 && traceJobs[jobOrder[k - 1]].bytes < traceJobs[v].bytes) {
+            jobOrder[k] = jobOrder[k - 1];
+            k--;
+        }
+        jobOrder[k] = v;
+    }
+}
+
+/** Simulate one manifest job against its own cache instance.
+ *
+ * The trace is mapped and replayed straight into the job's instance;
+ * none of the global single-run machinery (decode batch, samplers,
+ * instrumentation) is involved, so jobs are independent.
+ *
+ * @param the job.
+ * @return None.
+ */
+static void run_trace_job(TraceJob *j) {
+    init_cache(&j->cache, j->s, j->b, j->E);
+    Cache *c = &j->cache;
+
+    int fd = open(j->trace, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error opening'%s'\n", j->trace);
+        exit(1);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return;
+    }
+    const char *buf =
+        (const char *)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE,
+                           fd, 0);
+    close(fd);
+    if (buf == MAP_FAILED) {
+        fprintf(stderr, "Error opening'%s'\n", j->trace);
+        exit(1);
+    }
+
+    const char *p = buf, *end = buf + st.st_size;
+    char action;
+    unsigned long addr;
+    int size;
+    while (scan_ascii_record(&p, end, &action, &addr, &size)) {
+        if (size < 0 || size >= MAX_SIZE) {
+            printf("Size is out of range\n");
+            exit(1);
+        }
+        if (action != 'L' && action != 'S') {
+            printf("Invalid action\n");
+            exit(1);
+        }
+        cache_access(c, &c->stats, action, addr);
+    }
+    munmap((void *)buf, (size_t)st.st_size);
+}
+
+/** Pool worker: take the next scheduled job until none are left.
+ *
+ * @param unused.
+ * @return NULL.
+ */
+static void *job_worker(void *arg) {
+    (void)arg;
+    for (;;) {
+        int i = atomic_fetch_add(&nextTraceJob, 1);
+        if (i >= nTraceJobs) {
+            return NULL;
+        }
+        run_trace_job(&traceJobs[jobOrder[i]]);
+    }
+}
+
+/** Run every manifest job on a thread pool and report per-job rows.
+ *
+ * @param the number of pool threads.
+ * @return None.
+ */
+static void run_job_manifest(int nThreads) {
+    if (nThreads < 1) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        nThreads = n > 0 ? (int)n : 1;
+    }
+    if (nThreads > nTraceJobs) {
+        nThreads = nTraceJobs;
+    }
+
+    atomic_store(&nextTraceJob, 0);
+    pthread_t *tids = (pthread_t *)malloc(sizeof(pthread_t) *
+                                          (unsigned long)nThreads);
+    if (!tids) {
+        printf("Failed to allocate memory.\n");
+        exit(1);
+    }
+    for (int i = 0; i < nThreads; i++) {
+        if (pthread_create(&tids[i], NULL, job_worker, NULL)) {
+            printf("Failed to create worker threads.\n");
+            exit(1);
+        }
+    }
+    for (int i = 0; i < nThreads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    free(tids);
+
+    // per-job rows in manifest order, then the aggregate
+    SimStats total;
+    memset(&total, 0, sizeof(total));
+    long totalDirty = 0, totalDirtyEvicted = 0;
+    for (int i = 0; i < nTraceJobs; i++) {
+        Cache *c = &traceJobs[i].cache;
+        printf("job %d: %s s=%i, E=%i, b=%i hits:%ld misses:%ld "
+               "evictions:%ld dirty_bytes_in_cache:%ld "
+               "dirty_bytes_evicted:%ld\n",
+               i, traceJobs[i].trace, c->s, c->E, c->b, c->stats.hit,
+               c->stats.miss, c->stats.eviction, c->stats.dirtyInCache * c->B,
+               c->stats.dirtyEvicted * c->B);
+        total.hit += c->stats.hit;
+        total.miss += c->stats.miss;
+        total.eviction += c->stats.eviction;
+        totalDirty += c->stats.dirtyInCache * c->B;
+        totalDirtyEvicted += c->stats.dirtyEvicted * c->B;
+        free_cache(c);
+    }
+    printf("total: hits:%ld misses:%ld evictions:%ld "
+           "dirty_bytes_in_cache:%ld dirty_bytes_evicted:%ld\n",
+           total.hit, total.miss, total.eviction, totalDirty,
+           totalDirtyEvicted);
+    free(traceJobs);
+    free(jobOrder);
+}
+
+int main(int argc, char *argv[]) {
+    int opt, hflag = 0, vflag = 0, tflag = 0, Tflag = 0, s = -1, b = -1,
+        E = -1;
+    char t[1000];
+    char sweepFile[1000];
+    char levelSpec[1000];
+    char manifestFile[1000];
+    int Sflag = 0, Lflag = 0, Mflag = 0;
+
+    // Parse the command line into options
+    int jthreads = 0;
+
+    int aflag = 0;
+
+    char saveFile[1000];
+    char restoreFile[1000];
+    int Cflag = 0, Rflag = 0;
+
+    int mflag = 0;
+
+    char classifyLogFile[1000];
+    int classifyLogFlag = 0;
+    char intervalLogFile[1000];
+    int intervalLogFlag = 0;
+    int tlbS = 0, tlbE = 0, tlbP = 12;
+    char heatmapFile[1000];
+
+    char verboseLogFile[1000];
+
+    // long-only options take values past the printable range
+    enum {
+        OPT_CLASSIFY = 256,
+        OPT_CLASSIFY_LOG,
+        OPT_CLASSIFY_INTERVAL,
+        OPT_VERBOSE_LOG,
+        OPT_SAMPLE,
+        OPT_SAMPLE_INTERVAL,
+        OPT_SAMPLE_WARMUP,
+        OPT_PREFETCH,
+        OPT_INTERVAL,
+        OPT_INTERVAL_LOG,
+        OPT_TLB,
+        OPT_HEATMAP,
+        OPT_COLLAPSE,
+        OPT_SCALAR,
+        OPT_COST,
+        OPT_COST_CYCLES,
+    };
+    static const struct option longOpts[] = {
+        {"classify", no_argument, NULL, OPT_CLASSIFY},
+        {"classify-log", required_argument, NULL, OPT_CLASSIFY_LOG},
+        {"classify-interval", required_argument, NULL, OPT_CLASSIFY_INTERVAL},
+        {"verbose-log", required_argument, NULL, OPT_VERBOSE_LOG},
+        {"sample", required_argument, NULL, OPT_SAMPLE},
+        {"sample-interval", required_argument, NULL, OPT_SAMPLE_INTERVAL},
+        {"sample-warmup", required_argument, NULL, OPT_SAMPLE_WARMUP},
+        {"prefetch", required_argument, NULL, OPT_PREFETCH},
+        {"interval", required_argument, NULL, OPT_INTERVAL},
+        {"interval-log", required_argument, NULL, OPT_INTERVAL_LOG},
+        {"tlb", required_argument, NULL, OPT_TLB},
+        {"heatmap", required_argument, NULL, OPT_HEATMAP},
+        {"collapse", no_argument, NULL, OPT_COLLAPSE},
+        {"scalar", no_argument, NULL, OPT_SCALAR},
+        {"cost", no_argument, NULL, OPT_COST},
+        {"cost-cycles", required_argument, NULL, OPT_COST_CYCLES},
+        {NULL, 0, NULL, 0},
+    };
+
+    while ((opt = getopt_long(argc, argv, "haBmvs:b:E:t:T:j:M:S:L:p:w:C:R:",
+                              longOpts, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            hflag = 1;
+            break;
+
+        case 'a':
+            aflag = 1;
+            break;
+
+        case 'B':
+            benchMode = 1;
+            break;
+
+        case 'm':
+            mflag = 1;
+            break;
+
+        case 'v':
+            vflag = 1;
+            verboseMode = 1;
+            break;
+
+        case 's':
+            s = atoi(optarg);
+            break;
+
+        case 'b':
+            b = atoi(optarg);
+            break;
+
+        case 'E':
+            E = atoi(optarg);
+            break;
+
+        case 't':
+            tflag = 1;
+            strcpy(t, optarg);
+            break;
+
+        case 'T':
+            Tflag = 1;
+            strcpy(t, optarg);
+            break;
+
+        case 'j':
+            jthreads = atoi(optarg);
+            break;
+
+        case 'S':
+            Sflag = 1;
+            strcpy(sweepFile, optarg);
+            break;
+
+        case 'M':
+            Mflag = 1;
+            strcpy(manifestFile, optarg);
+            break;
+
+        case 'C':
+            Cflag = 1;
+            strcpy(saveFile, optarg);
+            break;
+
+        case 'R':
+            Rflag = 1;
+            strcpy(restoreFile, optarg);
+            break;
+
+        case 'p':
+            if (strcmp(optarg, "lru") == 0) {
+                defaultPolicy = REPL_LRU;
+            } else if (strcmp(optarg, "plru") == 0) {
+                defaultPolicy = REPL_PLRU;
+            } else if (strcmp(optarg, "srrip") == 0) {
+                defaultPolicy = REPL_SRRIP;
+            } else if (strcmp(optarg, "brrip") == 0) {
+                defaultPolicy = REPL_BRRIP;
+            } else if (strcmp(optarg, "rand") == 0) {
+                defaultPolicy = REPL_RAND;
+            } else {
+                printf("Unknown replacement policy '%s'\n", optarg);
+                exit(1);
+            }
+            break;
+
+        case 'L':
+            Lflag = 1;
+            strcpy(levelSpec, optarg);
+            break;
+
+        case 'w':
+            if (strcmp(optarg, "wb-wa") == 0) {
+                defaultWritePolicy = WP_WB_WA;
+            } else if (strcmp(optarg, "wb-nwa") == 0) {
+                defaultWritePolicy = WP_WB_NWA;
+            } else if (strcmp(optarg, "wt-wa") == 0) {
+                defaultWritePolicy = WP_WT_WA;
+            } else if (strcmp(optarg, "wt-nwa") == 0) {
+                defaultWritePolicy = WP_WT_NWA;
+            } else {
+                printf("Unknown write policy '%s'\n", optarg);
+                exit(1);
+            }
+            break;
+
+        case OPT_CLASSIFY:
+            classifyMode = 1;
+            break;
+
+        case OPT_CLASSIFY_LOG:
+            classifyMode = 1;
+            classifyLogFlag = 1;
+            strcpy(classifyLogFile, optarg);
+            break;
+
+        case OPT_CLASSIFY_INTERVAL:
+            classifyInterval = atol(optarg);
+            if (classifyInterval <= 0) {
+                printf("Incorrect Invocations.\n");
+                exit(1);
+            }
+            break;
+
+        case OPT_VERBOSE_LOG:
+            verboseMode = 1;
+            verbBinary = 1;
+            strcpy(verboseLogFile, optarg);
+            break;
+
+        case OPT_SAMPLE: {
+            // accepts "1/64" and plain "64"
+            const char *rate = strchr(optarg, '/');
+            if (rate && atol(optarg) != 1) {
+                printf("Incorrect Invocations.\n");
+                exit(1);
+            }
+            sampleMode = 1;
+            sampleRate = atol(rate ? rate + 1 : optarg);
+            if (sampleRate <= 0) {
+                printf("Incorrect Invocations.\n");
+                exit(1);
+            }
+            break;
+        }
+
+        case OPT_SAMPLE_INTERVAL:
+            sampleMode = 1;
+            sampleInterval = atol(optarg);
+            if (sampleInterval <= 0) {
+                printf("Incorrect Invocations.\n");
+                exit(1);
+            }
+            break;
+
+        case OPT_SAMPLE_WARMUP:
+            sampleWarmup = atol(optarg);
+            if (sampleWarmup < 0) {
+                printf("Incorrect Invocations.\n");
+                exit(1);
+            }
+            break;
+
+        case OPT_PREFETCH:
+            if (strncmp(optarg, "next", 4) == 0) {
+                prefetchMode = PREFETCH_NEXT;
+                if (optarg[4] == ':') {
+                    pfDegree = atoi(optarg + 5);
+                }
+                if (optarg[4] != '\0' && optarg[4] != ':') {
+                    printf("Unknown prefetcher '%s'\n", optarg);
+                    exit(1);
+                }
+                if (pfDegree <= 0 || pfDegree > PF_PENDING) {
+                    printf("Incorrect Invocations.\n");
+                    exit(1);
+                }
+            } else if (strcmp(optarg, "stride") == 0) {
+                prefetchMode = PREFETCH_STRIDE;
+            } else {
+                printf("Unknown prefetcher '%s'\n", optarg);
+                exit(1);
+            }
+            break;
+
+        case OPT_INTERVAL:
+            intervalMode = 1;
+            intervalLen = atol(optarg);
+            if (intervalLen <= 0) {
+                printf("Incorrect Invocations.\n");
+                exit(1);
+            }
+            break;
+
+        case OPT_INTERVAL_LOG:
+            intervalLogFlag = 1;
+            strcpy(intervalLogFile, optarg);
+            break;
+
+        case OPT_TLB:
+            tlbMode = 1;
+            if (sscanf(optarg, "%d,%d,%d", &tlbS, &tlbE, &tlbP) < 2 ||
+                tlbS < 0 || tlbE <= 0 || tlbP <= 0 || tlbS + tlbP > 64) {
+                printf("Incorrect Invocations.\n");
+                exit(1);
+            }
+            break;
+
+        case OPT_HEATMAP:
+            heatmapMode = 1;
+            strcpy(heatmapFile, optarg);
+            break;
+
+        case OPT_COLLAPSE:
+            collapseMode = 1;
+            break;
+
+        case OPT_SCALAR:
+            scalarMode = 1;
+            break;
+
+        case OPT_COST:
+            costMode = 1;
+            break;
+
+        case OPT_COST_CYCLES:
+            costMode = 1;
+            if (sscanf(optarg, "%ld,%ld,%ld", &costHit, &costMiss,
+                       &costWb) < 2 ||
+                costHit < 0 || costMiss < 0) {
+                printf("Incorrect Invocations.\n");
+                exit(1);
+            }
+            break;
+
+        default:
+            printf("Error while parsing arguments.\n");
+            exit(1);
+        }
+    }
+
+    // detect whether arguments are not options or values for values
+    if (optind < argc) {
+        printf("Invalid input\n");
+        exit(1);
+    }
+
+#if defined(__x86_64__)
+    // probe once at startup; the job-pool threads only read the flag
+    haveAvx2 = __builtin_cpu_supports("avx2") && !scalarMode;
+#endif
+
+    // if -h is given, print the help message
+    if (hflag) {
+        print_help();
+        return 0;
+    }
+
+    // if -v is given, verbose mode is on
+    if (vflag) {
+        printf("verbose mode on\n");
+    }
+    if (verbBinary) {
+        verbFd = open(verboseLogFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (verbFd < 0) {
+            printf("Failed to open the verbose log.\n");
+            exit(1);
+        }
+    }
+
+    // the job driver owns the whole run; the single-run modes and their
+    // instrumentation do not combine with it
+    if (Mflag) {
+        if (tflag || Tflag || Sflag || Lflag || Cflag || Rflag || aflag ||
+            mflag || benchMode || classifyMode || prefetchMode ||
+            verboseMode || sampleMode || intervalMode || tlbMode ||
+            heatmapMode || costMode) {
+            printf("Incorrect Invocations.\n");
+            exit(1);
+        }
+        load_job_manifest(manifestFile);
+        run_job_manifest(jthreads);
+        arena_release();
+        return 0;
+    }
+
+    // the shadow structures are global and updated in trace order, so
+    // classification is serial and tracks a single configuration
+    if (classifyMode && (Sflag || jthreads > 1)) {
+        printf("Incorrect Invocations.\n");
+        exit(1);
+    }
+
+    // verbose output pairs each record with its outcome in trace order,
+    // so it is serial and tracks a single configuration as well
+    if (verboseMode && (Sflag || jthreads > 1)) {
+        printf("Incorrect Invocations.\n");
+        exit(1);
+    }
+
+    // sampling estimates one configuration serially, and mixing it with
+    // the exact-reporting modes would only mislead
+    if (sampleMode &&
+        (Sflag || jthreads > 1 || classifyMode || verboseMode ||
+         heatmapMode || costMode)) {
+        printf("Incorrect Invocations.\n");
+        exit(1);
+    }
+    if (costWb < 0) {
+        costWb = costMiss;
+    }
+    if (sampleMode && sampleWarmup < 0) {
+        sampleWarmup = sampleInterval / 4;
+    }
+    if (sampleMode && sampleInterval > 0 && sampleWarmup >= sampleInterval) {
+        printf("Incorrect Invocations.\n");
+        exit(1);
+    }
+
+    // the prefetch engine runs ahead of a single serial demand stream
+    if (prefetchMode && (Sflag || jthreads > 1)) {
+        printf("Incorrect Invocations.\n");
+        exit(1);
+    }
+
+    // rand and brrip draw from one generator per instance; sharded
+    // workers would race on it and victim choice would depend on the
+    // schedule instead of the seed
+    if ((defaultPolicy == REPL_RAND || defaultPolicy == REPL_BRRIP) &&
+        jthreads > 1) {
+        printf("Incorrect Invocations.\n");
+        exit(1);
+    }
+
+    // interval rows report the serial counters of the main cache, and
+    // sampled counters would need the end-of-run scaling to mean anything
+    if (intervalMode && (Sflag || jthreads > 1 || sampleMode)) {
+        printf("Incorrect Invocations.\n");
+        exit(1);
+    }
+
+    // the page table is rebuilt per run, so a restored run would see a
+    // different first-touch frame assignment than the run that saved it
+    if (tlbMode && (Cflag || Rflag)) {
+        printf("Incorrect Invocations.\n");
+        exit(1);
+    }
+
+    // the heat counters track the single main configuration
+    if (heatmapMode && Sflag) {
+        printf("Incorrect Invocations.\n");
+        exit(1);
+    }
+
+    // the translation stage feeds every downstream mode, so it is set up
+    // before the sweep branch takes over the run
+    if (tlbMode) {
+        tlb_init(tlbS, tlbE, tlbP);
+    }
+
+    // sweep mode replays the trace through every listed configuration in
+    // one pass; the per-run -s/-E/-b and -j options do not apply
+    if (Sflag) {
+        if (!(tflag || Tflag) || jthreads > 1) {
+            printf("Incorrect Invocations.\n");
+            exit(1);
+        }
+        load_sweep_configs(sweepFile);
+        if (Tflag) {
+            process_trace_packed(t);
+        } else {
+            process_trace_file(t);
+        }
+
+        csim_stats_t sweepStats;
+        memset(&sweepStats, 0, sizeof(sweepStats));
+        for (int i = 0; i < nSweep; i++) {
+            Cache *c = &sweepCaches[i];
+            printf("s=%i, E=%i, b=%i\n", c->s, c->E, c->b);
+            sweepStats.hits = (unsigned long)c->stats.hit;
+            sweepStats.misses = (unsigned long)c->stats.miss;
+            sweepStats.evictions = (unsigned long)c->stats.eviction;
+            sweepStats.dirty_bytes =
+                (unsigned long)(c->stats.dirtyInCache * c->B);
+            sweepStats.dirty_evictions =
+                (unsigned long)(c->stats.dirtyEvicted * c->B);
+            sweepStats.write_traffic =
+                (unsigned long)(c->stats.writeThrough * c->B);
+            sweepStats.write_stats = defaultWritePolicy != WP_WB_WA;
+            sweepStats.tlb_hits = (unsigned long)tlbCache.stats.hit;
+            sweepStats.tlb_misses = (unsigned long)tlbCache.stats.miss;
+            sweepStats.tlb_stats = tlbMode != 0;
+            if (costMode) {
+                long refs = c->stats.hit + c->stats.miss;
+                long cycles =
+                    refs * costHit + c->stats.miss * costMiss +
+                    (c->stats.dirtyEvicted + c->stats.writeThrough) * costWb;
+                sweepStats.total_cycles = (unsigned long)cycles;
+                sweepStats.amat =
+                    refs > 0 ? (double)cycles / (double)refs : 0;
+            }
+            sweepStats.cost_stats = costMode != 0;
+            printSummary(&sweepStats);
+            free_cache(c);
+        }
+        free(sweepCaches);
+        arena_release();
+        return 0;
+    }
+
+    if (Rflag) {
+        if (!(tflag || Tflag)) {
+            printf("Incorrect Invocations.\n");
+            exit(1);
+        }
+        restore_state(&mainCache, restoreFile, s, b, E);
+        s = mainCache.s;
+        b = mainCache.b;
+        E = mainCache.E;
+    } else {
+        checkValidInput(s, b, E, (tflag || Tflag) ? t : NULL);
+        init_cache(&mainCache, s, b, E);
+    }
+    printf("s=%i, E=%i, b=%i\n", s, E, b);
+
+    if (heatmapMode) {
+        heatmap_init();
+    }
+    if (classifyMode) {
+        classify_init(&mainCache);
+        if (classifyLogFlag) {
+            classifyLog = fopen(classifyLogFile, "w");
+            if (!classifyLog) {
+                printf("Failed to open the classification log.\n");
+                exit(1);
+            }
+            fprintf(classifyLog, "# accesses compulsory capacity conflict\n");
+        }
+    }
+
+    // set sharding only partitions the first level, so the hierarchy mode
+    // is serial
+    if (Lflag) {
+        if (jthreads > 1) {
+            printf("Incorrect Invocations.\n");
+            exit(1);
+        }
+        load_hierarchy_spec(levelSpec);
+        mainCache.next = &extraLevels[0];
+    }
+    // after the hierarchy exists, so the kernel choice can see it
+    decode_init();
+
+    if (intervalMode) {
+        interval_init(intervalLogFlag ? intervalLogFile : NULL);
+    }
+
+    // one worker thread is just the serial path with extra copies
+    if (jthreads > 1) {
+        start_workers(jthreads);
+    }
+    // the benchmark batcher simulates on the parsing thread, so the
+    // asynchronous pipeline is pointless under -B
+    if (benchMode && aflag) {
+        printf("Incorrect Invocations.\n");
+        exit(1);
+    }
+    if (benchMode) {
+        bench_lap(); // start the parse clock
+    }
+    // verbose text goes to stdout with raw writes, so stdio output must
+    // not be left buffered behind it
+    if (verboseMode && !verbBinary) {
+        fflush(stdout);
+    }
+    if (aflag) {
+        asyncPipe = 1;
+        ReaderArgs ra = {t, Tflag};
+        pthread_t readerTid;
+        if (pthread_create(&readerTid, NULL, reader_main, &ra)) {
+            printf("Failed to create reader thread.\n");
+            exit(1);
+        }
+        drain_pipe();
+        pthread_join(readerTid, NULL);
+    } else if (Tflag) {
+        process_trace_packed(t);
+    } else if (mflag) {
+        process_trace_shared(t);
+    } else {
+        process_trace_file(t);
+    }
+    if (benchMode) {
+        bench_flush();
+    }
+    flush_decode_batch();
+    if (nWorkers > 0) {
+        finish_workers();
+    }
+    if (intervalMode) {
+        interval_finish();
+    }
+    if (verboseMode) {
+        verbose_flush();
+        if (verbBinary) {
+            close(verbFd);
+        }
+    }
+    if (Cflag) {
+        save_state(&mainCache, saveFile);
+    }
+    // flush any trailing partial interval before reporting
+    if (classifyLog) {
+        if (classifyAccesses % classifyInterval != 0) {
+            fprintf(classifyLog, "%ld %ld %ld %ld\n", classifyAccesses,
+                    classifyCompulsory - lastCompulsory,
+                    classifyCapacity - lastCapacity,
+                    classifyConflict - lastConflict);
+        }
+        fclose(classifyLog);
+    }
+
+    // print the result
+    csim_stats_t *stats = malloc(sizeof(csim_stats_t));
+    stats->hits = (unsigned long)mainCache.stats.hit;
+    stats->misses = (unsigned long)mainCache.stats.miss;
+    stats->evictions = (unsigned long)mainCache.stats.eviction;
+    stats->dirty_bytes = (unsigned long)(mainCache.stats.dirtyInCache * mainCache.B);
+    stats->dirty_evictions =
+        (unsigned long)(mainCache.stats.dirtyEvicted * mainCache.B);
+    if (sampleMode) {
+        sample_finish(stats);
+    }
+    stats->compulsory_misses = (unsigned long)classifyCompulsory;
+    stats->capacity_misses = (unsigned long)classifyCapacity;
+    stats->conflict_misses = (unsigned long)classifyConflict;
+    stats->miss_breakdown = classifyMode != 0;
+    stats->prefetches = (unsigned long)pfIssued;
+    stats->prefetch_useful = (unsigned long)pfUseful;
+    stats->prefetch_useless = (unsigned long)pfUseless;
+    stats->prefetch_late = (unsigned long)pfLate;
+    stats->prefetch_stats = prefetchMode != 0;
+    stats->write_traffic =
+        (unsigned long)(mainCache.stats.writeThrough * mainCache.B);
+    stats->write_stats = defaultWritePolicy != WP_WB_WA;
+    stats->tlb_hits = (unsigned long)tlbCache.stats.hit;
+    stats->tlb_misses = (unsigned long)tlbCache.stats.miss;
+    stats->tlb_stats = tlbMode != 0;
+    if (costMode) {
+        long refs = mainCache.stats.hit + mainCache.stats.miss;
+        long cycles = refs * costHit;
+        Cache *last = &mainCache;
+        for (int i = 0; i < nExtraLevels; i++) {
+            Cache *c = &extraLevels[i];
+            cycles += (c->stats.hit + c->stats.miss) * costHit;
+            last = c;
+        }
+        // only the last level talks to memory; the inner levels' misses,
+        // writebacks and written-through stores are its accesses already
+        cycles += last->stats.miss * costMiss +
+                  (last->stats.dirtyEvicted + last->stats.writeThrough) *
+                      costWb;
+        stats->total_cycles = (unsigned long)cycles;
+        stats->amat = refs > 0 ? (double)cycles / (double)refs : 0;
+    }
+    stats->cost_stats = costMode != 0;
+    printSummary(stats);
+    if (sampleMode) {
+        printf("sample: measured=%ld of %ld accesses\n", sampleCounted,
+               sampleTotal);
+    }
+    if (heatmapMode) {
+        heatmap_report();
+        heatmap_dump(heatmapFile);
+    }
+    if (benchMode) {
+        reportSec += bench_lap();
+        long accesses = mainCache.stats.hit + mainCache.stats.miss;
+        double total = parseSec + simSec + reportSec;
+        printf("bench: parse_s=%.6f simulate_s=%.6f report_s=%.6f "
+               "accesses=%ld accesses_per_s=%.0f\n",
+               parseSec, simSec, reportSec, accesses,
+               total > 0 ? (double)accesses / total : 0);
+    }
+
+    // per-level traffic of the extra hierarchy levels (L1 is above)
+    for (int i = 0; i < nExtraLevels; i++) {
+        Cache *c = &extraLevels[i];
+        printf("L%d (s=%i, E=%i, b=%i) hits:%ld misses:%ld evictions:%ld "
+               "dirty_bytes_in_cache:%ld dirty_bytes_evicted:%ld\n",
+               i + 2, c->s, c->E, c->b, c->stats.hit, c->stats.miss,
+               c->stats.eviction, c->stats.dirtyInCache * c->B,
+               c->stats.dirtyEvicted * c->B);
+        free_cache(c);
+    }
+
+    // free memory
+    if (classifyMode) {
+        free_classify();
+    }
+    if (tlbMode) {
+        free_tlb();
+    }
+    if (heatmapMode) {
+        free(setStats);
     }
-    free(cache);
+    free_cache(&mainCache);
+    arena_release();
     free(stats);
 
     return 0;
@@ -0,0 +1,97 @@
+/**
+ * @file tracepack.c
+ * @brief Converts an ASCII memory trace into the packed binary format
+ *
+ * Reads "<op> <hex-addr>,<size>" records and writes the fixed 8-byte
+ * records described in tracepack.h. Packed traces are ~3x smaller than
+ * the ASCII form and csim can replay them with no parsing at all via
+ * its -T option.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tracepack.h"
+
+/** @brief Number of records buffered between writes */
+#define PACK_BUFLEN 65536
+
+static void usage(const char *prog) {
+    printf("Usage: %s <trace.txt> <trace.bin>\n", prog);
+    printf("Converts an ASCII trace into a packed binary trace.\n");
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE *in = fopen(argv[1], "rt");
+    if (!in) {
+        fprintf(stderr, "Error opening'%s'\n", argv[1]);
+        return 1;
+    }
+    FILE *out = fopen(argv[2], "wb");
+    if (!out) {
+        fprintf(stderr, "Error opening'%s'\n", argv[2]);
+        fclose(in);
+        return 1;
+    }
+
+    trace_rec_t magic = TRACEPACK_MAGIC;
+    if (fwrite(&magic, sizeof(magic), 1, out) != 1) {
+        fprintf(stderr, "Error writing'%s'\n", argv[2]);
+        return 1;
+    }
+
+    static trace_rec_t buf[PACK_BUFLEN];
+    size_t used = 0;
+    unsigned long records = 0;
+    unsigned long addr;
+    int size;
+    char action;
+
+    // pack each ASCII record into a fixed 8-byte record
+    while (fscanf(in, " %c %lx,%d", &action, &addr, &size) > 0) {
+        unsigned long op;
+        switch (action) {
+        case 'L':
+            op = TRACE_OP_LOAD;
+            break;
+
+        case 'S':
+            op = TRACE_OP_STORE;
+            break;
+
+        default:
+            printf("Invalid action\n");
+            return 1;
+        }
+
+        if (addr != (addr & TRACE_ADDR_MASK)) {
+            printf("Address %lx is out of range\n", addr);
+            return 1;
+        }
+
+        buf[used++] = trace_rec_pack(op, addr, (unsigned long)size);
+        records++;
+        if (used == PACK_BUFLEN) {
+            if (fwrite(buf, sizeof(trace_rec_t), used, out) != used) {
+                fprintf(stderr, "Error writing'%s'\n", argv[2]);
+                return 1;
+            }
+            used = 0;
+        }
+    }
+
+    if (used > 0 && fwrite(buf, sizeof(trace_rec_t), used, out) != used) {
+        fprintf(stderr, "Error writing'%s'\n", argv[2]);
+        return 1;
+    }
+
+    fclose(in);
+    fclose(out);
+    printf("packed %lu records\n", records);
+    return 0;
+}
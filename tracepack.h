@@ -0,0 +1,49 @@
+/**
+ * @file tracepack.h
+ * @brief Packed binary trace record format shared by csim and tracepack
+ *
+ * A packed trace is a magic word followed by fixed 8-byte records, each
+ * holding the operation, access size and a 48-bit address. Streaming these
+ * with bulk reads avoids re-parsing ASCII on every simulation sweep.
+ */
+
+#ifndef TRACEPACK_H
+#define TRACEPACK_H
+
+#include <stdint.h>
+
+/** @brief Magic word leading a packed trace file ("csmtrc01") */
+#define TRACEPACK_MAGIC 0x63736d7472633031UL
+
+/** @brief Operation codes stored in the top byte of a record */
+#define TRACE_OP_LOAD 0UL
+#define TRACE_OP_STORE 1UL
+
+/** @brief Mask selecting the 48 address bits of a record */
+#define TRACE_ADDR_MASK 0xffffffffffffUL
+
+/** @brief One packed trace record: op | size | 48-bit address */
+typedef uint64_t trace_rec_t;
+
+/** @brief Pack one access into a record */
+static inline trace_rec_t trace_rec_pack(unsigned long op, unsigned long addr,
+                                         unsigned long size) {
+    return (op << 56) | ((size & 0xffUL) << 48) | (addr & TRACE_ADDR_MASK);
+}
+
+/** @brief Extract the operation code of a record */
+static inline unsigned long trace_rec_op(trace_rec_t rec) {
+    return rec >> 56;
+}
+
+/** @brief Extract the access size of a record */
+static inline unsigned long trace_rec_size(trace_rec_t rec) {
+    return (rec >> 48) & 0xffUL;
+}
+
+/** @brief Extract the address of a record */
+static inline unsigned long trace_rec_addr(trace_rec_t rec) {
+    return rec & TRACE_ADDR_MASK;
+}
+
+#endif /* TRACEPACK_H */